@@ -0,0 +1,2 @@
+add_executable(pika-bench bench/bench.cpp)
+target_link_libraries(pika-bench snmallocshim benchmark::benchmark absl::strings absl::flat_hash_map pika)
@@ -0,0 +1,324 @@
+#include "bench_grammar.hpp"
+
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <new>
+#include <pika/graph.hpp>
+#include <pika/limits.hpp>
+#include <pika/memotable.hpp>
+#include <pika/peg.hpp>
+#include <sys/resource.h>
+
+/*
+ * Every allocation made through operator new is counted, so that the
+ * benchmarks can report allocations per parse.
+ */
+static std::atomic<size_t> allocations{0};
+
+void* operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto pointer = std::malloc(size ? size : 1))
+    {
+        return pointer;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+
+namespace pika
+{
+    namespace bench
+    {
+        /*
+         * A parse that runs out of memory or time is reported as an error
+         * instead of taking the whole run down. Both can be changed through
+         * the environment.
+         */
+        static size_t environment(const char* name, size_t fallback)
+        {
+            auto value = std::getenv(name);
+            return value ? std::strtoull(value, nullptr, 10) : fallback;
+        }
+
+        static void apply_limits(pika::limits::Limits& limits)
+        {
+            static const auto memory =
+                environment("PIKA_BENCH_MEMORY_LIMIT", size_t{8} << 30);
+            static const auto timeout =
+                environment("PIKA_BENCH_TIMEOUT", 60);
+            limits.set_memory_limit(memory);
+            limits.set_timeout(std::chrono::seconds(timeout));
+        }
+
+        static size_t peak_rss()
+        {
+            rusage usage{};
+            getrusage(RUSAGE_SELF, &usage);
+            return static_cast<size_t>(usage.ru_maxrss) * 1024;
+        }
+
+        static void report(
+            benchmark::State& state,
+            size_t input_size,
+            size_t entries,
+            size_t memory,
+            size_t allocated)
+        {
+            using benchmark::Counter;
+            state.SetBytesProcessed(
+                static_cast<int64_t>(state.iterations() * input_size));
+            state.counters["entries/byte"] =
+                static_cast<double>(entries) / input_size;
+            state.counters["memo_bytes"] = Counter(
+                static_cast<double>(memory),
+                Counter::kDefaults,
+                Counter::kIs1024);
+            state.counters["allocs"] = Counter(
+                static_cast<double>(allocated), Counter::kAvgIterations);
+            state.counters["peak_rss"] = Counter(
+                static_cast<double>(peak_rss()),
+                Counter::kDefaults,
+                Counter::kIs1024);
+        }
+
+        /*
+         * With `LengthOnly`, the time and memory include rebuilding the tree
+         * of the toplevel match.
+         */
+        template<typename Grammar, bool LengthOnly = false>
+        static void pika_engine(benchmark::State& state, Generator generate)
+        {
+            auto input = generate(static_cast<size_t>(state.range(0)));
+            size_t entries = 0, memory = 0;
+            auto before = allocations.load(std::memory_order_relaxed);
+            for (auto _ : state)
+            {
+                auto table = pika::graph::construct_table(Grammar(), input);
+                table.length_only = LengthOnly;
+                apply_limits(table.memo_table.limits);
+                try
+                {
+                    auto result = table.match();
+                    benchmark::DoNotOptimize(result);
+                    if (!result)
+                    {
+                        state.SkipWithError("input was not matched");
+                        break;
+                    }
+                }
+                catch (const pika::limits::Aborted& aborted)
+                {
+                    state.SkipWithError(aborted.what());
+                    break;
+                }
+                entries = table.memo_table.size();
+                memory = table.memory_usage();
+            }
+            report(
+                state,
+                input.size(),
+                entries,
+                memory,
+                allocations.load(std::memory_order_relaxed) - before);
+        }
+
+        template<typename Grammar>
+        static void packrat_engine(benchmark::State& state, Generator generate)
+        {
+            auto input = generate(static_cast<size_t>(state.range(0)));
+            size_t entries = 0, memory = 0;
+            auto before = allocations.load(std::memory_order_relaxed);
+            for (auto _ : state)
+            {
+                pika::memotable::MemoTable table(input, Grammar());
+                apply_limits(table.limits);
+                try
+                {
+                    auto result = Grammar().packrat_match(table, 0);
+                    benchmark::DoNotOptimize(result);
+                    if (!result)
+                    {
+                        state.SkipWithError("input was not matched");
+                        break;
+                    }
+                }
+                catch (const pika::limits::Aborted& aborted)
+                {
+                    state.SkipWithError(aborted.what());
+                    break;
+                }
+                entries = table.packrat_size();
+                memory = table.memory_usage();
+            }
+            report(
+                state,
+                input.size(),
+                entries,
+                memory,
+                allocations.load(std::memory_order_relaxed) - before);
+        }
+
+        /*
+         * The interpreters of pika::peg, running the grammar loaded from
+         * `text` once up front; its first rule is the toplevel.
+         */
+        static void peg_pika_engine(
+            benchmark::State& state, const char* text, Generator generate)
+        {
+            auto input = generate(static_cast<size_t>(state.range(0)));
+            auto grammar = pika::peg::Grammar::load(text);
+            size_t entries = 0;
+            auto before = allocations.load(std::memory_order_relaxed);
+            for (auto _ : state)
+            {
+                pika::peg::PikaTable table(*grammar, input);
+                table.match();
+                if (table.lookup(0, 0) == pika::peg::NO_MATCH)
+                {
+                    state.SkipWithError("input was not matched");
+                    break;
+                }
+                entries = table.entries();
+            }
+            report(
+                state,
+                input.size(),
+                entries,
+                0,
+                allocations.load(std::memory_order_relaxed) - before);
+        }
+
+        static void peg_packrat_engine(
+            benchmark::State& state, const char* text, Generator generate)
+        {
+            auto input = generate(static_cast<size_t>(state.range(0)));
+            auto grammar = pika::peg::Grammar::load(text);
+            size_t entries = 0;
+            auto before = allocations.load(std::memory_order_relaxed);
+            for (auto _ : state)
+            {
+                pika::peg::Packrat packrat(*grammar, input);
+                if (packrat.match(0, 0) == pika::peg::NO_MATCH)
+                {
+                    state.SkipWithError("input was not matched");
+                    break;
+                }
+                entries = packrat.entries();
+            }
+            report(
+                state,
+                input.size(),
+                entries,
+                0,
+                allocations.load(std::memory_order_relaxed) - before);
+        }
+
+        /*
+         * Inputs grow tenfold from 1 KiB up to a per-engine limit. The
+         * packrat engine recurses once per nesting level or right-recursive
+         * term, so its limit is bounded by the stack, and it cannot handle
+         * left recursion at all, which is marked by a zero limit. The pika
+         * engine keeps every intermediate match of a left-recursive rule
+         * alive, which is quadratic in both time and memory.
+         */
+        template<typename Grammar>
+        static void register_grammar(
+            const std::string& name,
+            Generator generate,
+            size_t pika_limit,
+            size_t packrat_limit)
+        {
+            for (size_t size = 1024; size <= pika_limit; size *= 10)
+            {
+                benchmark::RegisterBenchmark(
+                    ("pika/" + name).c_str(), pika_engine<Grammar>, generate)
+                    ->Arg(static_cast<int64_t>(size))
+                    ->Unit(benchmark::kMillisecond);
+                benchmark::RegisterBenchmark(
+                    ("pika-lengths/" + name).c_str(),
+                    pika_engine<Grammar, true>,
+                    generate)
+                    ->Arg(static_cast<int64_t>(size))
+                    ->Unit(benchmark::kMillisecond);
+            }
+            for (size_t size = 1024; size <= packrat_limit; size *= 10)
+            {
+                benchmark::RegisterBenchmark(
+                    ("packrat/" + name).c_str(),
+                    packrat_engine<Grammar>,
+                    generate)
+                    ->Arg(static_cast<int64_t>(size))
+                    ->Unit(benchmark::kMillisecond);
+            }
+        }
+
+        /*
+         * The loaded grammars, with the same limits as the compiled ones up
+         * to 10 MiB.
+         */
+        static void register_peg(
+            const std::string& name,
+            const char* text,
+            Generator generate,
+            size_t pika_limit,
+            size_t packrat_limit)
+        {
+            for (size_t size = 1024; size <= pika_limit; size *= 10)
+            {
+                benchmark::RegisterBenchmark(
+                    ("peg-pika/" + name).c_str(),
+                    peg_pika_engine,
+                    text,
+                    generate)
+                    ->Arg(static_cast<int64_t>(size))
+                    ->Unit(benchmark::kMillisecond);
+            }
+            for (size_t size = 1024; size <= packrat_limit; size *= 10)
+            {
+                benchmark::RegisterBenchmark(
+                    ("peg-packrat/" + name).c_str(),
+                    peg_packrat_engine,
+                    text,
+                    generate)
+                    ->Arg(static_cast<int64_t>(size))
+                    ->Unit(benchmark::kMillisecond);
+            }
+        }
+    } // namespace bench
+} // namespace pika
+
+int main(int argc, char** argv)
+{
+    using namespace pika::bench;
+    constexpr size_t KIB = 1024, MIB = KIB * 1024;
+    register_grammar<Toplevel>(
+        "arithmetic", arithmetic_input, 100 * MIB, 100 * KIB);
+    register_grammar<JsonDocument>("json", json_input, 100 * MIB, 100 * MIB);
+    register_grammar<ListDocument>("list", list_input, 10 * KIB, 0);
+    register_grammar<NestedDocument>(
+        "nested", nested_input, 100 * MIB, 10 * KIB);
+    register_peg(
+        "arithmetic", ARITHMETIC_PEG, arithmetic_input, 10 * MIB, 100 * KIB);
+    register_peg("json", JSON_PEG, json_input, 10 * MIB, 10 * MIB);
+    register_peg("list", LIST_PEG, list_input, 10 * KIB, 0);
+    register_peg("nested", NESTED_PEG, nested_input, 10 * MIB, 10 * KIB);
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
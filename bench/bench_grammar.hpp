@@ -0,0 +1,307 @@
+#ifndef PIKA_BENCH_GRAMMAR_HPP
+#define PIKA_BENCH_GRAMMAR_HPP
+
+#include <pika/clause.hpp>
+#include <pika/clause.ipp>
+#include <random>
+#include <string>
+
+using namespace pika::clause;
+
+/*
+ * The arithmetic grammar of tests/test_clause.hpp.
+ */
+struct Additive;
+struct Multiplicative;
+
+PIKA_DECLARE(Digit, PIKA_CHAR_RANGE('0', '9'), false);
+
+PIKA_DECLARE(Number, PIKA_PLUS(Digit), true);
+
+PIKA_DECLARE(
+    Primary,
+    PIKA_ORD(PIKA_SEQ(PIKA_CHAR('('), Additive, PIKA_CHAR(')')), Number),
+    true);
+
+PIKA_DECLARE(
+    Multiplicative,
+    PIKA_ORD(PIKA_SEQ(Primary, PIKA_CHAR('*'), Multiplicative), Primary),
+    true);
+
+PIKA_DECLARE(
+    Additive,
+    PIKA_ORD(
+        PIKA_SEQ(Multiplicative, PIKA_CHAR('+'), Additive), Multiplicative),
+    true);
+
+PIKA_DECLARE(
+    Toplevel,
+    PIKA_SEQ(PIKA_FIRST, Additive, PIKA_NOT_FOLLOWED_BY(PIKA_ANY)),
+    true);
+
+/*
+ * JSON without unicode escapes and exponents.
+ */
+struct JsonValue;
+
+PIKA_DECLARE(
+    JsonSpace,
+    PIKA_ASTERISKS(PIKA_ORD(
+        PIKA_CHAR(' '), PIKA_CHAR('\t'), PIKA_CHAR('\n'), PIKA_CHAR('\r'))),
+    false);
+
+PIKA_DECLARE(
+    JsonString,
+    PIKA_SEQ(
+        PIKA_CHAR('"'),
+        PIKA_ASTERISKS(PIKA_ORD(
+            PIKA_SEQ(PIKA_CHAR('\\'), PIKA_ANY),
+            PIKA_SEQ(PIKA_NOT_FOLLOWED_BY(PIKA_CHAR('"')), PIKA_ANY))),
+        PIKA_CHAR('"')),
+    true);
+
+PIKA_DECLARE(
+    JsonNumber,
+    PIKA_SEQ(
+        PIKA_OPTIONAL(PIKA_CHAR('-')),
+        PIKA_PLUS(Digit),
+        PIKA_OPTIONAL(PIKA_SEQ(PIKA_CHAR('.'), PIKA_PLUS(Digit)))),
+    true);
+
+PIKA_DECLARE(
+    JsonLiteral,
+    PIKA_ORD(
+        PIKA_SEQ(
+            PIKA_CHAR('t'), PIKA_CHAR('r'), PIKA_CHAR('u'), PIKA_CHAR('e')),
+        PIKA_SEQ(
+            PIKA_CHAR('f'),
+            PIKA_CHAR('a'),
+            PIKA_CHAR('l'),
+            PIKA_CHAR('s'),
+            PIKA_CHAR('e')),
+        PIKA_SEQ(
+            PIKA_CHAR('n'), PIKA_CHAR('u'), PIKA_CHAR('l'), PIKA_CHAR('l'))),
+    true);
+
+PIKA_DECLARE(
+    JsonMember,
+    PIKA_SEQ(JsonSpace, JsonString, JsonSpace, PIKA_CHAR(':'), JsonValue),
+    true);
+
+PIKA_DECLARE(
+    JsonObject,
+    PIKA_SEQ(
+        PIKA_CHAR('{'),
+        JsonSpace,
+        PIKA_OPTIONAL(PIKA_SEQ(
+            JsonMember, PIKA_ASTERISKS(PIKA_SEQ(PIKA_CHAR(','), JsonMember)))),
+        PIKA_CHAR('}')),
+    true);
+
+PIKA_DECLARE(
+    JsonArray,
+    PIKA_SEQ(
+        PIKA_CHAR('['),
+        JsonSpace,
+        PIKA_OPTIONAL(PIKA_SEQ(
+            JsonValue, PIKA_ASTERISKS(PIKA_SEQ(PIKA_CHAR(','), JsonValue)))),
+        PIKA_CHAR(']')),
+    true);
+
+PIKA_DECLARE(
+    JsonValue,
+    PIKA_SEQ(
+        JsonSpace,
+        PIKA_ORD(JsonObject, JsonArray, JsonString, JsonNumber, JsonLiteral),
+        JsonSpace),
+    true);
+
+PIKA_DECLARE(
+    JsonDocument,
+    PIKA_SEQ(PIKA_FIRST, JsonValue, PIKA_NOT_FOLLOWED_BY(PIKA_ANY)),
+    true);
+
+/*
+ * A comma separated list of words, left recursive.
+ */
+struct WordList;
+
+PIKA_DECLARE(Word, PIKA_PLUS(PIKA_CHAR_RANGE('a', 'z')), true);
+
+PIKA_DECLARE(
+    WordList,
+    PIKA_ORD(PIKA_SEQ(WordList, PIKA_CHAR(','), Word), Word),
+    true);
+
+PIKA_DECLARE(
+    ListDocument,
+    PIKA_SEQ(PIKA_FIRST, WordList, PIKA_NOT_FOLLOWED_BY(PIKA_ANY)),
+    true);
+
+/*
+ * Brackets nested as deep as the input goes. Every level first tries to
+ * close with the wrong bracket, so an unmemoized parser is exponential.
+ */
+struct Nested;
+
+PIKA_DECLARE(
+    Nested,
+    PIKA_ORD(
+        PIKA_SEQ(PIKA_CHAR('('), Nested, PIKA_CHAR(']')),
+        PIKA_SEQ(PIKA_CHAR('('), Nested, PIKA_CHAR(')')),
+        PIKA_CHAR('x')),
+    true);
+
+PIKA_DECLARE(
+    NestedDocument,
+    PIKA_SEQ(PIKA_FIRST, Nested, PIKA_NOT_FOLLOWED_BY(PIKA_ANY)),
+    true);
+
+namespace pika
+{
+    namespace bench
+    {
+        using Generator = std::string (*)(size_t);
+
+        /*
+         * The grammars above as PEG text for pika::peg, with the toplevel
+         * first.
+         */
+        constexpr char ARITHMETIC_PEG[] = R"(
+            Toplevel <- Additive !.
+            Additive <- Multiplicative '+' Additive / Multiplicative
+            Multiplicative <- Primary '*' Multiplicative / Primary
+            Primary <- '(' Additive ')' / Number
+            Number <- Digit+
+            ~Digit <- [0-9]
+        )";
+
+        constexpr char JSON_PEG[] = R"(
+            JsonDocument <- JsonValue !.
+            JsonValue <- JsonSpace
+                (JsonObject / JsonArray / JsonString / JsonNumber /
+                 JsonLiteral) JsonSpace
+            JsonObject <- '{' JsonSpace (JsonMember (',' JsonMember)*)? '}'
+            JsonArray <- '[' JsonSpace (JsonValue (',' JsonValue)*)? ']'
+            JsonMember <- JsonSpace JsonString JsonSpace ':' JsonValue
+            JsonString <- '"' ('\\' . / !'"' .)* '"'
+            JsonNumber <- '-'? Digit+ ('.' Digit+)?
+            JsonLiteral <- 'true' / 'false' / 'null'
+            ~JsonSpace <- [ \t\n\r]*
+            ~Digit <- [0-9]
+        )";
+
+        constexpr char LIST_PEG[] = R"(
+            ListDocument <- WordList !.
+            WordList <- WordList ',' Word / Word
+            Word <- [a-z]+
+        )";
+
+        constexpr char NESTED_PEG[] = R"(
+            NestedDocument <- Nested !.
+            Nested <- '(' Nested ']' / '(' Nested ')' / 'x'
+        )";
+
+        /*
+         * Input generators: deterministic for a given size, and at least
+         * `size` bytes long.
+         */
+        inline std::string arithmetic_input(size_t size)
+        {
+            std::mt19937 engine(size);
+            std::string input;
+            input.reserve(size + 64);
+            auto number = [&]() {
+                input.append(std::to_string(engine() % 10000));
+            };
+            auto operation = [&]() {
+                input.push_back(engine() % 2 ? '+' : '*');
+            };
+            number();
+            while (input.size() < size)
+            {
+                operation();
+                if (engine() % 4)
+                {
+                    number();
+                    continue;
+                }
+                input.push_back('(');
+                number();
+                for (auto terms = engine() % 8; terms; --terms)
+                {
+                    operation();
+                    number();
+                }
+                input.push_back(')');
+            }
+            return input;
+        }
+
+        inline std::string json_input(size_t size)
+        {
+            std::mt19937 engine(size);
+            std::string input = "[\n";
+            input.reserve(size + 256);
+            while (true)
+            {
+                auto id = engine();
+                input.append("  {\"id\": ")
+                    .append(std::to_string(id % 100000));
+                input.append(", \"name\": \"item \\\"")
+                    .append(std::to_string(id % 997))
+                    .append("\\\"\"");
+                input.append(", \"score\": -")
+                    .append(std::to_string(id % 100))
+                    .append(".")
+                    .append(std::to_string(id % 7));
+                input.append(
+                    ", \"tags\": [\"a\", \"b\", {\"nested\": [1, 2]}]");
+                input.append(", \"ok\": ").append(id % 2 ? "true" : "false");
+                input.append(", \"next\": null}");
+                if (input.size() + 3 >= size)
+                {
+                    break;
+                }
+                input.append(",\n");
+            }
+            input.append("\n]");
+            return input;
+        }
+
+        inline std::string list_input(size_t size)
+        {
+            std::mt19937 engine(size);
+            std::string input;
+            input.reserve(size + 16);
+            while (true)
+            {
+                for (auto length = 1 + engine() % 8; length; --length)
+                {
+                    input.push_back(static_cast<char>('a' + engine() % 26));
+                }
+                if (input.size() >= size)
+                {
+                    break;
+                }
+                input.push_back(',');
+            }
+            return input;
+        }
+
+        inline std::string nested_input(size_t size)
+        {
+            std::mt19937 engine(size);
+            auto depth = size / 2;
+            std::string input(depth, '(');
+            input.push_back('x');
+            for (size_t i = 0; i < depth; ++i)
+            {
+                input.push_back(engine() % 2 ? ')' : ']');
+            }
+            return input;
+        }
+    } // namespace bench
+} // namespace pika
+
+#endif // PIKA_BENCH_GRAMMAR_HPP
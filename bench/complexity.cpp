@@ -0,0 +1,215 @@
+#include "bench_grammar.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <gtest/gtest.h>
+#include <iomanip>
+#include <iostream>
+#include <pika/graph.hpp>
+#include <pika/memotable.hpp>
+
+/*
+ * Runs the benchmark grammars at geometric input sizes and fits the growth
+ * of the operation counters against the input length. Counters are used
+ * instead of time so that the verdict does not depend on the machine; the
+ * time is printed alongside for reference only.
+ */
+namespace pika
+{
+    namespace bench
+    {
+        using pika::memotable::OperationCounters;
+
+        struct Sample
+        {
+            size_t size;
+            OperationCounters counters;
+            double seconds;
+        };
+
+        /*
+         * Upper bounds for a grammar and engine: the fitted exponent of every
+         * counter, and the total operations per input byte at the largest
+         * size. The bounds sit about 20% above the measured values; lower
+         * them when a change makes parsing cheaper.
+         */
+        struct Budget
+        {
+            double exponent;
+            double work_per_byte;
+        };
+
+        using Counter = size_t OperationCounters::*;
+
+        static const std::pair<const char*, Counter> COUNTERS[] = {
+            {"columns", &OperationCounters::columns},
+            {"evaluations", &OperationCounters::evaluations},
+            {"pushes", &OperationCounters::pushes},
+            {"insertions", &OperationCounters::insertions},
+            {"hits", &OperationCounters::hits},
+        };
+
+        static size_t work(const OperationCounters& counters)
+        {
+            return counters.evaluations + counters.pushes +
+                counters.insertions + counters.hits;
+        }
+
+        template<typename Grammar>
+        static Sample pika_sample(const std::string& input)
+        {
+            auto start = std::chrono::steady_clock::now();
+            auto table = pika::graph::construct_table(Grammar(), input);
+            EXPECT_TRUE(table.match());
+            std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+            return {input.size(), table.memo_table.counters, elapsed.count()};
+        }
+
+        template<typename Grammar>
+        static Sample packrat_sample(const std::string& input)
+        {
+            auto start = std::chrono::steady_clock::now();
+            pika::memotable::MemoTable table(input, Grammar());
+            EXPECT_TRUE(Grammar().packrat_match(table, 0));
+            std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+            return {input.size(), table.counters, elapsed.count()};
+        }
+
+        /*
+         * Least squares slope of log(counter) against log(size), or NaN when
+         * the counter stays at zero for some size.
+         */
+        static double
+        fit_exponent(const std::vector<Sample>& samples, Counter counter)
+        {
+            double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+            for (auto& sample : samples)
+            {
+                if (sample.counters.*counter == 0)
+                {
+                    return NAN;
+                }
+                auto x = std::log(static_cast<double>(sample.size));
+                auto y =
+                    std::log(static_cast<double>(sample.counters.*counter));
+                n += 1;
+                sx += x;
+                sy += y;
+                sxx += x * x;
+                sxy += x * y;
+            }
+            return (n * sxy - sx * sy) / (n * sxx - sx * sx);
+        }
+
+        template<typename Sampler>
+        static void check(
+            const char* name,
+            Generator generate,
+            std::initializer_list<size_t> sizes,
+            Sampler sample,
+            Budget budget)
+        {
+            std::vector<Sample> samples;
+            for (auto size : sizes)
+            {
+                samples.push_back(sample(generate(size)));
+            }
+            std::cout << name << ":" << std::endl;
+            for (auto& i : samples)
+            {
+                std::cout << std::setw(10) << i.size << " bytes, "
+                          << std::setw(10) << work(i.counters) << " ops, "
+                          << std::fixed << std::setprecision(4) << i.seconds
+                          << " s" << std::endl;
+            }
+            for (auto& [counter_name, counter] : COUNTERS)
+            {
+                auto exponent = fit_exponent(samples, counter);
+                if (std::isnan(exponent))
+                {
+                    continue;
+                }
+                std::cout << "  " << counter_name << " ~ n^" << exponent
+                          << std::endl;
+                EXPECT_LE(exponent, budget.exponent)
+                    << name << ": " << counter_name << " scales as n^"
+                    << exponent;
+            }
+            auto& largest = samples.back();
+            auto per_byte =
+                static_cast<double>(work(largest.counters)) / largest.size;
+            std::cout << "  " << per_byte << " ops/byte" << std::endl;
+            EXPECT_LE(per_byte, budget.work_per_byte)
+                << name << ": " << per_byte << " operations per byte";
+        }
+    } // namespace bench
+} // namespace pika
+
+using namespace pika::bench;
+
+TEST(Complexity, Arithmetic)
+{
+    check(
+        "pika/arithmetic",
+        arithmetic_input,
+        {1024, 2048, 4096, 8192, 16384},
+        pika_sample<Toplevel>,
+        {1.1, 38});
+    check(
+        "packrat/arithmetic",
+        arithmetic_input,
+        {1024, 2048, 4096, 8192, 16384},
+        packrat_sample<Toplevel>,
+        {1.1, 4});
+}
+
+TEST(Complexity, Json)
+{
+    check(
+        "pika/json",
+        json_input,
+        {1024, 2048, 4096, 8192, 16384},
+        pika_sample<JsonDocument>,
+        {1.1, 77});
+    check(
+        "packrat/json",
+        json_input,
+        {1024, 2048, 4096, 8192, 16384},
+        packrat_sample<JsonDocument>,
+        {1.1, 5.7});
+}
+
+TEST(Complexity, List)
+{
+    // Every column grows its own left-recursive list up to the end of input.
+    check(
+        "pika/list",
+        list_input,
+        {256, 512, 1024, 2048},
+        pika_sample<ListDocument>,
+        {2.1, 1850});
+}
+
+TEST(Complexity, Nested)
+{
+    check(
+        "pika/nested",
+        nested_input,
+        {1024, 2048, 4096, 8192, 16384},
+        pika_sample<NestedDocument>,
+        {1.1, 18});
+    check(
+        "packrat/nested",
+        nested_input,
+        {1024, 2048, 4096, 8192, 16384},
+        packrat_sample<NestedDocument>,
+        {1.1, 4.2});
+}
+
+int main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,89 @@
+#ifndef PIKA_ANALYSIS_HPP
+#define PIKA_ANALYSIS_HPP
+
+#include <bitset>
+#include <pika/clause.hpp>
+#include <vector>
+
+namespace pika
+{
+    namespace analysis
+    {
+        /*
+         * Input symbols are the 256 byte values plus the end of input.
+         */
+        constexpr size_t END_OF_INPUT = 256;
+        constexpr size_t SYMBOLS = 257;
+
+        using SymbolSet = std::bitset<SYMBOLS>;
+
+        /*
+         * What a clause may match at a position, judged by the symbol found
+         * there. `first` holds the symbols at which any match, even an empty
+         * one, is possible; `consuming` those at which a non-empty match is.
+         * Both are over-approximations, except that `exact` clauses match at
+         * exactly the symbols of `first` (single-symbol terminals).
+         */
+        struct FirstSet
+        {
+            SymbolSet first;
+            SymbolSet consuming;
+            bool nullable = false;
+            bool exact = false;
+
+            bool operator==(const FirstSet& that) const noexcept;
+
+            bool operator!=(const FirstSet& that) const noexcept;
+
+            /*
+             * Matches every symbol, possibly empty: the set of a clause
+             * nothing is known about.
+             */
+            static FirstSet anything() noexcept;
+
+            /*
+             * A terminal consuming one of `symbols`.
+             */
+            static FirstSet terminal(const SymbolSet& symbols) noexcept;
+
+            /*
+             * Matches empty at `symbols` and consumes nothing.
+             */
+            static FirstSet lookahead(const SymbolSet& symbols) noexcept;
+
+            /*
+             * `this` followed by `next`, and the choice between `this` and
+             * `alternative`.
+             */
+            [[nodiscard]] FirstSet then(const FirstSet& next) const noexcept;
+
+            [[nodiscard]] FirstSet
+            otherwise(const FirstSet& alternative) const noexcept;
+        };
+
+        /*
+         * FIRST sets and nullability of every clause reachable from a
+         * toplevel clause, solved as a fixed point so that recursive rules are
+         * handled. Indexed by Clause::clause_id.
+         */
+        class Analysis
+        {
+            std::vector<FirstSet> sets;
+
+          public:
+            explicit Analysis(const clause::Clause& toplevel);
+
+            /*
+             * The set computed so far; clauses outside the grammar start out
+             * matching nothing.
+             */
+            [[nodiscard]] FirstSet
+            operator[](const clause::Clause& clause) const;
+
+            [[nodiscard]] bool
+            viable(const clause::Clause& clause, size_t symbol) const;
+        };
+    }
+}
+
+#endif // PIKA_ANALYSIS_HPP
@@ -3,11 +3,15 @@
 
 #include <absl/container/flat_hash_map.h>
 #include <absl/container/flat_hash_set.h>
+#include <absl/container/inlined_vector.h>
+#include <array>
 #include <optional>
 #include <ostream>
 #include <queue>
 #include <tuple>
+#include <type_traits>
 #include <typeindex>
+#include <utility>
 #include <vector>
 
 namespace pika
@@ -26,6 +30,11 @@ namespace pika
     {
         struct ClauseTable;
     }
+    namespace analysis
+    {
+        struct FirstSet;
+        class Analysis;
+    }
     namespace clause
     {
         struct Clause
@@ -42,13 +51,41 @@ namespace pika
 
             [[nodiscard]] virtual const Clause* get_instance() const = 0;
 
+            /*
+             * A dense per-type identifier, handed out on first use. It
+             * indexes the packrat memo rows of a MemoTable.
+             */
+            [[nodiscard]] virtual size_t clause_id() const = 0;
+
+            [[nodiscard]] static size_t next_clause_id() noexcept;
+
             [[nodiscard]] virtual bool active() const;
             ;
 
+            /*
+             * Whether packrat matching may memorize this clause, see
+             * PIKA_DECLARE_UNMEMOIZED.
+             */
+            [[nodiscard]] virtual bool memoizable() const;
+
             [[nodiscard]] virtual std::shared_ptr<pika::memotable::Match>
             packrat_match(
                 pika::memotable::MemoTable& table, size_t index) const;
 
+            /*
+             * The match of this clause with its sub-matches, recovered from
+             * `match` at `position`, which the pika engine stored without
+             * them, see memotable::Match::UNEXPANDED. Built in `scratch`, a
+             * table over the same input; null if the clause does not match
+             * there again. Unless overridden, the clause is packrat matched
+             * again.
+             */
+            [[nodiscard]] virtual std::shared_ptr<pika::memotable::Match>
+            expand(
+                const pika::memotable::Match& match,
+                size_t position,
+                pika::memotable::MemoTable& scratch) const;
+
             [[nodiscard]] virtual pika::type_utils::BaseType
             get_base_type() const noexcept;
 
@@ -57,6 +94,14 @@ namespace pika
                 std::vector<const Clause*>& terminals,
                 std::vector<const Clause*>& nodes) const = 0;
             virtual void mark_seeds(graph::ClauseTable& table) const;
+            virtual void sub_clauses(std::vector<const Clause*>& output) const;
+
+            /*
+             * This clause's FIRST set given the sets of its sub-clauses
+             * computed so far, see analysis::Analysis.
+             */
+            [[nodiscard]] virtual analysis::FirstSet
+            first_set(const analysis::Analysis& analysis) const;
             virtual void pika_match(graph::ClauseTable& table) const = 0;
         };
 
@@ -65,6 +110,11 @@ namespace pika
     { \
         static std::decay_t<typeof(*this)> INIT; \
         return &INIT; \
+    } \
+    size_t clause_id() const override \
+    { \
+        static const size_t ID = pika::clause::Clause::next_clause_id(); \
+        return ID; \
     }
 
 #define PIKA_DFS_CHECK(BLOCK) \
@@ -108,6 +158,157 @@ namespace pika
                 get_base_type() const noexcept override;
             };
 
+            struct String : public Terminal
+            {
+                [[nodiscard]] pika::type_utils::BaseType
+                get_base_type() const noexcept override;
+
+                /*
+                 * The bytes matched, without the quotes of display().
+                 */
+                [[nodiscard]] virtual std::string_view
+                literal() const noexcept = 0;
+            };
+
+            struct CharSet : public Terminal
+            {
+                [[nodiscard]] pika::type_utils::BaseType
+                get_base_type() const noexcept override;
+            };
+
+            /*
+             * Membership bits of a character class written like the inside
+             * of a regular expression bracket, "a-zA-Z_". A '-' that does
+             * not sit between two characters stands for itself.
+             */
+            constexpr std::array<uint64_t, 4>
+            char_set_members(std::string_view spec)
+            {
+                std::array<uint64_t, 4> members{};
+                for (size_t i = 0; i < spec.size(); ++i)
+                {
+                    unsigned start = static_cast<unsigned char>(spec[i]);
+                    unsigned end = start;
+                    if (i + 2 < spec.size() && spec[i + 1] == '-')
+                    {
+                        end = static_cast<unsigned char>(spec[i + 2]);
+                        i += 2;
+                    }
+                    for (auto c = start; c <= end; ++c)
+                    {
+                        members[c / 64] |= uint64_t{1} << (c % 64);
+                    }
+                }
+                return members;
+            }
+
+            struct Keywords : public Terminal
+            {
+                [[nodiscard]] pika::type_utils::BaseType
+                get_base_type() const noexcept override;
+            };
+
+            /*
+             * A trie over the whitespace separated keywords of `spec`, built
+             * at compile time. Nodes are linked to their first child and
+             * next sibling; `keyword` is the index of the first keyword
+             * ending at a node. N bounds the number of nodes and keywords.
+             */
+            template<size_t N>
+            struct KeywordTrie
+            {
+                constexpr static size_t NONE = static_cast<size_t>(-1);
+
+                struct Node
+                {
+                    char label = 0;
+                    size_t first_child = NONE;
+                    size_t next_sibling = NONE;
+                    size_t keyword = NONE;
+                };
+
+                std::array<Node, N + 1> nodes{};
+                std::array<std::string_view, N> keywords{};
+                size_t size = 1;
+                size_t count = 0;
+                size_t longest = 0;
+
+                constexpr size_t child(size_t node, char label) const
+                {
+                    auto i = nodes[node].first_child;
+                    while (i != NONE && nodes[i].label != label)
+                    {
+                        i = nodes[i].next_sibling;
+                    }
+                    return i;
+                }
+
+                constexpr explicit KeywordTrie(std::string_view spec)
+                {
+                    size_t i = 0;
+                    while (i < spec.size())
+                    {
+                        if (spec[i] == ' ' || spec[i] == '\t' ||
+                            spec[i] == '\n')
+                        {
+                            i += 1;
+                            continue;
+                        }
+                        auto start = i;
+                        size_t node = 0;
+                        for (; i < spec.size() && spec[i] != ' ' &&
+                             spec[i] != '\t' && spec[i] != '\n';
+                             ++i)
+                        {
+                            auto next = child(node, spec[i]);
+                            if (next == NONE)
+                            {
+                                next = size++;
+                                nodes[next].label = spec[i];
+                                nodes[next].next_sibling =
+                                    nodes[node].first_child;
+                                nodes[node].first_child = next;
+                            }
+                            node = next;
+                        }
+                        if (nodes[node].keyword == NONE)
+                        {
+                            nodes[node].keyword = count;
+                        }
+                        keywords[count++] = spec.substr(start, i - start);
+                        if (i - start > longest)
+                        {
+                            longest = i - start;
+                        }
+                    }
+                }
+
+                /*
+                 * The keyword that a PEG choice over the keywords in order
+                 * would match at the start of `input`, as its index and
+                 * length; NONE if there is none.
+                 */
+                constexpr std::pair<size_t, size_t>
+                match(std::string_view input) const
+                {
+                    std::pair<size_t, size_t> result{NONE, 0};
+                    size_t node = 0;
+                    for (size_t i = 0; i < input.size(); ++i)
+                    {
+                        node = child(node, input[i]);
+                        if (node == NONE)
+                        {
+                            break;
+                        }
+                        if (nodes[node].keyword < result.first)
+                        {
+                            result = {nodes[node].keyword, i + 1};
+                        }
+                    }
+                    return result;
+                }
+            };
+
             struct Seq : public NonTerminal
             {
                 [[nodiscard]] pika::type_utils::BaseType
@@ -132,6 +333,33 @@ namespace pika
                 get_base_type() const noexcept override;
             };
 
+            struct Repeat : public NonTerminal
+            {
+                [[nodiscard]] pika::type_utils::BaseType
+                get_base_type() const noexcept override;
+
+                /*
+                 * The least number of repetitions; with none the clause
+                 * matches at every position.
+                 */
+                [[nodiscard]] virtual size_t minimum() const noexcept = 0;
+
+                [[nodiscard]] virtual size_t maximum() const noexcept = 0;
+            };
+
+            /*
+             * Whether S matches a single byte tested by a static
+             * S::contains, like Char, CharRange, CharSet and Any.
+             */
+            template<typename S, typename = void>
+            struct ByteClass : std::false_type
+            {};
+
+            template<typename S>
+            struct ByteClass<S, std::void_t<decltype(S::contains('\0'))>>
+            : std::true_type
+            {};
+
             struct Optional : public NonTerminal
             {
                 [[nodiscard]] pika::type_utils::BaseType
@@ -149,6 +377,18 @@ namespace pika
                 [[nodiscard]] pika::type_utils::BaseType
                 get_base_type() const noexcept override;
             };
+
+            struct Infix : public NonTerminal
+            {
+                [[nodiscard]] pika::type_utils::BaseType
+                get_base_type() const noexcept override;
+            };
+
+            struct Precedence : public NonTerminal
+            {
+                [[nodiscard]] pika::type_utils::BaseType
+                get_base_type() const noexcept override;
+            };
         }
 
 #define DISPLAY(BLOCK) \
@@ -166,8 +406,15 @@ namespace pika
 
             DISPLAY({ return CLAUSE_LABEL; })
 
+            [[nodiscard]] static constexpr bool contains(char c) noexcept
+            {
+                return c == C;
+            }
+
             std::shared_ptr<pika::memotable::Match> packrat_match(
                 pika::memotable::MemoTable& table, size_t index) const override;
+            [[nodiscard]] analysis::FirstSet
+            first_set(const analysis::Analysis& analysis) const override;
             void pika_match(graph::ClauseTable& table) const override;
         };
 
@@ -180,8 +427,106 @@ namespace pika
 
             DISPLAY({ return CLAUSE_LABEL; })
 
+            [[nodiscard]] static constexpr bool contains(char c) noexcept
+            {
+                return c >= Start && c <= End;
+            }
+
+            std::shared_ptr<pika::memotable::Match> packrat_match(
+                pika::memotable::MemoTable& table, size_t index) const override;
+            [[nodiscard]] analysis::FirstSet
+            first_set(const analysis::Analysis& analysis) const override;
+            void pika_match(pika::graph::ClauseTable& table) const override;
+        };
+
+        /*
+         * A literal matched with a single comparison, producing one memo
+         * entry per occurrence instead of one per byte. Written as
+         * PIKA_STRING("while").
+         */
+        template<char... Cs>
+        struct String : _internal::String
+        {
+            PIKA_DEFAULT_INSTANCE;
+            constexpr static char VALUE[] = {Cs..., '\0'};
+            constexpr static char CLAUSE_LABEL[] = {'"', Cs..., '"', '\0'};
+
+            DISPLAY({ return CLAUSE_LABEL; })
+
+            [[nodiscard]] std::string_view literal() const noexcept override
+            {
+                return {VALUE, sizeof...(Cs)};
+            }
+
+            std::shared_ptr<pika::memotable::Match> packrat_match(
+                pika::memotable::MemoTable& table, size_t index) const override;
+            [[nodiscard]] analysis::FirstSet
+            first_set(const analysis::Analysis& analysis) const override;
+            void pika_match(pika::graph::ClauseTable& table) const override;
+        };
+
+        /*
+         * A character class tested with a single lookup in a 256-bit table,
+         * in place of an Ord of Char and CharRange alternatives. Written as
+         * PIKA_CHAR_SET("a-zA-Z_").
+         */
+        template<char... Cs>
+        struct CharSet : _internal::CharSet
+        {
+            PIKA_DEFAULT_INSTANCE;
+            constexpr static char SPEC[] = {Cs..., '\0'};
+            constexpr static std::array<uint64_t, 4> MEMBERS =
+                _internal::char_set_members({SPEC, sizeof...(Cs)});
+            constexpr static char CLAUSE_LABEL[] = {'[', Cs..., ']', '\0'};
+
+            DISPLAY({ return CLAUSE_LABEL; })
+
+            [[nodiscard]] static constexpr bool contains(char c) noexcept
+            {
+                auto byte = static_cast<unsigned char>(c);
+                return MEMBERS[byte / 64] >> (byte % 64) & 1;
+            }
+
+            std::shared_ptr<pika::memotable::Match> packrat_match(
+                pika::memotable::MemoTable& table, size_t index) const override;
+            [[nodiscard]] analysis::FirstSet
+            first_set(const analysis::Analysis& analysis) const override;
+            void pika_match(pika::graph::ClauseTable& table) const override;
+        };
+
+        /*
+         * A choice over whitespace separated keywords, matched by walking a
+         * compile-time trie in time linear in the keyword length instead of
+         * trying every alternative. Like an Ord of the keywords it matches
+         * the first one in order, whose index is kept as the match's
+         * sub_fst_idx and exposed by TreeNode::alternative. Written as
+         * PIKA_KEYWORDS("if else while").
+         */
+        template<char... Cs>
+        struct Keywords : _internal::Keywords
+        {
+            PIKA_DEFAULT_INSTANCE;
+            constexpr static char SPEC[] = {Cs..., '\0'};
+            constexpr static _internal::KeywordTrie<sizeof...(Cs)> TRIE{
+                std::string_view{SPEC, sizeof...(Cs)}};
+            constexpr static char CLAUSE_LABEL[] = {
+                'K', 'E', 'Y', 'W', 'O', 'R', 'D', 'S', '(', Cs..., ')', '\0'};
+
+            DISPLAY({ return CLAUSE_LABEL; })
+
+            /*
+             * The keyword with the given index, in the order written.
+             */
+            [[nodiscard]] static constexpr std::string_view
+            keyword(size_t index) noexcept
+            {
+                return TRIE.keywords[index];
+            }
+
             std::shared_ptr<pika::memotable::Match> packrat_match(
                 pika::memotable::MemoTable& table, size_t index) const override;
+            [[nodiscard]] analysis::FirstSet
+            first_set(const analysis::Analysis& analysis) const override;
             void pika_match(pika::graph::ClauseTable& table) const override;
         };
 
@@ -197,6 +542,8 @@ namespace pika
 
             [[nodiscard]] pika::type_utils::BaseType
             get_base_type() const noexcept override;
+            [[nodiscard]] analysis::FirstSet
+            first_set(const analysis::Analysis& analysis) const override;
             void pika_match(pika::graph::ClauseTable& table) const override;
         };
 
@@ -212,6 +559,8 @@ namespace pika
 
             [[nodiscard]] pika::type_utils::BaseType
             get_base_type() const noexcept override;
+            [[nodiscard]] analysis::FirstSet
+            first_set(const analysis::Analysis& analysis) const override;
             void pika_match(pika::graph::ClauseTable& table) const override;
         };
 
@@ -222,11 +571,42 @@ namespace pika
 
             DISPLAY({ return CLAUSE_LABEL; })
 
+            [[nodiscard]] static constexpr bool contains(char) noexcept
+            {
+                return true;
+            }
+
             std::shared_ptr<pika::memotable::Match> packrat_match(
                 pika::memotable::MemoTable& table, size_t index) const override;
 
             [[nodiscard]] pika::type_utils::BaseType
             get_base_type() const noexcept override;
+            [[nodiscard]] analysis::FirstSet
+            first_set(const analysis::Analysis& analysis) const override;
+            void pika_match(pika::graph::ClauseTable& table) const override;
+        };
+
+        /*
+         * Commits the innermost enclosing choice of a packrat parse, in the
+         * spirit of Mizushima et al.: an Ord does not try its remaining
+         * alternatives and a repetition does not fall back to its previous
+         * iteration. Memo entries that can no longer be reached by
+         * backtracking are evicted. Pika matching treats it as NOTHING.
+         */
+        struct Cut : public _internal::Terminal
+        {
+            PIKA_DEFAULT_INSTANCE;
+            constexpr static char CLAUSE_LABEL[] = "CUT";
+
+            DISPLAY({ return CLAUSE_LABEL; })
+
+            std::shared_ptr<pika::memotable::Match> packrat_match(
+                pika::memotable::MemoTable& table, size_t index) const override;
+
+            [[nodiscard]] pika::type_utils::BaseType
+            get_base_type() const noexcept override;
+            [[nodiscard]] analysis::FirstSet
+            first_set(const analysis::Analysis& analysis) const override;
             void pika_match(pika::graph::ClauseTable& table) const override;
         };
 
@@ -253,6 +633,15 @@ namespace pika
         {
             PIKA_DEFAULT_INSTANCE;
 
+            /*
+             * The sub-matches of a pika match being assembled, one per
+             * element, filled in by the element chain; a vector is only
+             * built for a complete match. The packrat engine, which recurses
+             * into the elements, stacks them on its table instead.
+             */
+            using Buffer =
+                std::array<std::shared_ptr<memotable::Match>, sizeof...(T) + 1>;
+
             virtual void dump_inner_unchecked(
                 std::ostream& output,
                 absl::flat_hash_set<std::type_index>& visited) const
@@ -338,17 +727,22 @@ namespace pika
                 pika::memotable::MemoTable& table,
                 size_t index,
                 size_t length,
-                std::vector<std::shared_ptr<pika::memotable::Match>>) const;
+                size_t base) const;
 
             std::shared_ptr<pika::memotable::Match> packrat_match(
                 pika::memotable::MemoTable& table, size_t index) const override;
 
             void mark_seeds(graph::ClauseTable& table) const override;
+            void sub_clauses(
+                std::vector<const Clause*>& output) const override;
+            [[nodiscard]] analysis::FirstSet
+            first_set(const analysis::Analysis& analysis) const override;
             void pika_match(pika::graph::ClauseTable& table) const override;
             virtual void pika_match_unchecked(
                 pika::graph::ClauseTable& table,
                 size_t length,
-                std::vector<std::shared_ptr<memotable::Match>>) const;
+                std::shared_ptr<memotable::Match>* matches,
+                size_t filled) const;
         };
 
         template<typename H>
@@ -356,6 +750,8 @@ namespace pika
         {
             PIKA_DEFAULT_INSTANCE;
 
+            using Buffer = std::array<std::shared_ptr<memotable::Match>, 1>;
+
             virtual void dump_inner_unchecked(
                 std::ostream& output,
                 absl::flat_hash_set<std::type_index>& visited) const
@@ -411,7 +807,7 @@ namespace pika
                 pika::memotable::MemoTable& table,
                 size_t index,
                 size_t length,
-                std::vector<std::shared_ptr<pika::memotable::Match>>) const;
+                size_t base) const;
 
             std::shared_ptr<pika::memotable::Match> packrat_match(
                 pika::memotable::MemoTable& table, size_t index) const override;
@@ -426,11 +822,16 @@ namespace pika
                 std::vector<const Clause*>& terminals,
                 std::vector<const Clause*>& nodes) const;
             void mark_seeds(pika::graph::ClauseTable& table) const override;
+            void sub_clauses(
+                std::vector<const Clause*>& output) const override;
+            [[nodiscard]] analysis::FirstSet
+            first_set(const analysis::Analysis& analysis) const override;
             void pika_match(pika::graph::ClauseTable& table) const override;
             virtual void pika_match_unchecked(
                 pika::graph::ClauseTable& table,
                 size_t length,
-                std::vector<std::shared_ptr<memotable::Match>>) const;
+                std::shared_ptr<memotable::Match>* matches,
+                size_t filled) const;
         };
 
         template<typename H, typename... T>
@@ -511,6 +912,11 @@ namespace pika
 
             std::shared_ptr<pika::memotable::Match> packrat_match(
                 pika::memotable::MemoTable& table, size_t index) const override;
+            virtual std::shared_ptr<pika::memotable::Match>
+            packrat_match_unchecked(
+                pika::memotable::MemoTable& table,
+                size_t index,
+                size_t order) const;
             void dfs_traversal(
                 absl::flat_hash_set<std::type_index>& visited,
                 std::vector<const Clause*>& terminals,
@@ -521,6 +927,10 @@ namespace pika
                 std::vector<const Clause*>& terminals,
                 std::vector<const Clause*>& nodes) const;
             void mark_seeds(pika::graph::ClauseTable& table) const override;
+            void sub_clauses(
+                std::vector<const Clause*>& output) const override;
+            [[nodiscard]] analysis::FirstSet
+            first_set(const analysis::Analysis& analysis) const override;
             void pika_match(pika::graph::ClauseTable& table) const override;
             virtual void pika_match_unchecked(
                 pika::graph::ClauseTable& table, size_t order) const;
@@ -584,6 +994,11 @@ namespace pika
 
             std::shared_ptr<pika::memotable::Match> packrat_match(
                 pika::memotable::MemoTable& table, size_t index) const override;
+            virtual std::shared_ptr<pika::memotable::Match>
+            packrat_match_unchecked(
+                pika::memotable::MemoTable& table,
+                size_t index,
+                size_t order) const;
 
             void dfs_traversal(
                 absl::flat_hash_set<std::type_index>& visited,
@@ -595,6 +1010,10 @@ namespace pika
                 std::vector<const Clause*>& terminals,
                 std::vector<const Clause*>& nodes) const;
             void mark_seeds(pika::graph::ClauseTable& table) const override;
+            void sub_clauses(
+                std::vector<const Clause*>& output) const override;
+            [[nodiscard]] analysis::FirstSet
+            first_set(const analysis::Analysis& analysis) const override;
             void pika_match(pika::graph::ClauseTable& table) const override;
             virtual void pika_match_unchecked(
                 pika::graph::ClauseTable& table, size_t order) const;
@@ -636,6 +1055,10 @@ namespace pika
                 std::vector<const Clause*>& terminals,
                 std::vector<const Clause*>& nodes) const override;
             void mark_seeds(pika::graph::ClauseTable& table) const override;
+            void sub_clauses(
+                std::vector<const Clause*>& output) const override;
+            [[nodiscard]] analysis::FirstSet
+            first_set(const analysis::Analysis& analysis) const override;
             void pika_match(pika::graph::ClauseTable& table) const override;
         };
 
@@ -675,7 +1098,92 @@ namespace pika
                 std::vector<const Clause*>& terminals,
                 std::vector<const Clause*>& nodes) const override;
             void mark_seeds(pika::graph::ClauseTable& table) const override;
+            void sub_clauses(
+                std::vector<const Clause*>& output) const override;
+            [[nodiscard]] analysis::FirstSet
+            first_set(const analysis::Analysis& analysis) const override;
+            void pika_match(pika::graph::ClauseTable& table) const override;
+        };
+
+        /*
+         * S repeated at least Min and at most Max times, greedily. A byte
+         * class S is matched by one bounded scan of the input instead of a
+         * match per repetition. Written as PIKA_REPEAT(S, Min, Max).
+         */
+        template<typename S, size_t Min, size_t Max>
+        struct Repeat : public _internal::Repeat
+        {
+            static_assert(Min <= Max && Max > 0, "invalid repetition bounds");
+
+            UNARY_DUMP(S);
+
+            PIKA_DEFAULT_INSTANCE;
+
+            DISPLAY({
+                static std::string CLAUSE_LABEL = {};
+                static bool INIT = false;
+                if (!INIT)
+                {
+                    INIT = true;
+                    CLAUSE_LABEL.append("( ");
+                    if (auto res = S().label())
+                    {
+                        CLAUSE_LABEL.append(
+                            res.value().begin(), res.value().end());
+                    }
+                    else
+                    {
+                        auto dis = S().display();
+                        CLAUSE_LABEL.append(dis.begin(), dis.end());
+                    }
+                    CLAUSE_LABEL.append(" ){")
+                        .append(std::to_string(Min))
+                        .append(",")
+                        .append(std::to_string(Max))
+                        .append("}");
+                }
+                return CLAUSE_LABEL;
+            })
+
+            [[nodiscard]] size_t minimum() const noexcept override
+            {
+                return Min;
+            }
+
+            [[nodiscard]] size_t maximum() const noexcept override
+            {
+                return Max;
+            }
+
+            std::shared_ptr<pika::memotable::Match> packrat_match(
+                pika::memotable::MemoTable& table, size_t index) const override;
+            void dfs_traversal(
+                absl::flat_hash_set<std::type_index>& visited,
+                std::vector<const Clause*>& terminals,
+                std::vector<const Clause*>& nodes) const override;
+            void mark_seeds(pika::graph::ClauseTable& table) const override;
+            void sub_clauses(
+                std::vector<const Clause*>& output) const override;
+            [[nodiscard]] analysis::FirstSet
+            first_set(const analysis::Analysis& analysis) const override;
             void pika_match(pika::graph::ClauseTable& table) const override;
+
+            /*
+             * Sub-matches are collected in place up to Max of them, or 8
+             * for longer repetitions.
+             */
+            using Buffer = absl::InlinedVector<
+                std::shared_ptr<pika::memotable::Match>,
+                (Max < 8 ? Max : 8)>;
+
+            /*
+             * The number of bytes of S, up to Max, found at index, and the
+             * sub-matches recorded for them: none unless S is active.
+             */
+            static size_t
+            scan(const pika::memotable::MemoTable& table, size_t index);
+            static Buffer scanned(
+                pika::memotable::MemoTable& table, size_t index, size_t count);
         };
 
         template<typename S>
@@ -714,6 +1222,10 @@ namespace pika
                 std::vector<const Clause*>& terminals,
                 std::vector<const Clause*>& nodes) const override;
             void mark_seeds(pika::graph::ClauseTable& table) const override;
+            void sub_clauses(
+                std::vector<const Clause*>& output) const override;
+            [[nodiscard]] analysis::FirstSet
+            first_set(const analysis::Analysis& analysis) const override;
             void pika_match(pika::graph::ClauseTable& table) const override;
         };
 
@@ -754,6 +1266,10 @@ namespace pika
                 std::vector<const Clause*>& terminals,
                 std::vector<const Clause*>& nodes) const override;
             void mark_seeds(pika::graph::ClauseTable& table) const override;
+            void sub_clauses(
+                std::vector<const Clause*>& output) const override;
+            [[nodiscard]] analysis::FirstSet
+            first_set(const analysis::Analysis& analysis) const override;
             void pika_match(pika::graph::ClauseTable& table) const override;
         };
 
@@ -793,57 +1309,293 @@ namespace pika
                 std::vector<const Clause*>& terminals,
                 std::vector<const Clause*>& nodes) const override;
             void mark_seeds(pika::graph::ClauseTable& table) const override;
+            void sub_clauses(
+                std::vector<const Clause*>& output) const override;
+            [[nodiscard]] analysis::FirstSet
+            first_set(const analysis::Analysis& analysis) const override;
+            void pika_match(pika::graph::ClauseTable& table) const override;
+        };
+
+
+        /*
+         * A binary operator level of a Precedence clause, written as
+         * PIKA_LEFT(Op) or PIKA_RIGHT(Op) for its associativity. It is never
+         * matched on its own; declared with PIKA_DECLARE it names the nodes
+         * built for its operator, whose sub-matches are the left operand,
+         * the operator and the right operand.
+         */
+        template<typename Op, bool RightAssociative>
+        struct Infix : public _internal::Infix
+        {
+            using Operator = Op;
+            constexpr static bool RIGHT = RightAssociative;
+
+            UNARY_DUMP(Op);
+
+            PIKA_DEFAULT_INSTANCE;
+
+            DISPLAY({
+                static std::string CLAUSE_LABEL = {};
+                static bool INIT = false;
+                if (!INIT)
+                {
+                    INIT = true;
+                    CLAUSE_LABEL.append(RIGHT ? "RIGHT( " : "LEFT( ");
+                    if (auto res = Op().label())
+                    {
+                        CLAUSE_LABEL.append(
+                            res.value().begin(), res.value().end());
+                    }
+                    else
+                    {
+                        auto dis = Op().display();
+                        CLAUSE_LABEL.append(dis.begin(), dis.end());
+                    }
+                    CLAUSE_LABEL.append(" )");
+                }
+                return CLAUSE_LABEL;
+            })
+
+            void dfs_traversal(
+                absl::flat_hash_set<std::type_index>& visited,
+                std::vector<const Clause*>& terminals,
+                std::vector<const Clause*>& nodes) const override;
+            void sub_clauses(
+                std::vector<const Clause*>& output) const override;
+            [[nodiscard]] analysis::FirstSet
+            first_set(const analysis::Analysis& analysis) const override;
             void pika_match(pika::graph::ClauseTable& table) const override;
         };
 
+        /*
+         * An expression of Operand clauses joined by the operators of
+         * Levels, listed from the loosest binding to the tightest, matched
+         * by precedence climbing within this one clause instead of a
+         * recursive rule per level. Builds the same binary nodes as a
+         * precedence ladder, tagged with their level.
+         *
+         * The pika engine shares the operator chains between the columns
+         * of an expression instead of building its nodes from every column,
+         * see Tail. Its matches are Match::UNEXPANDED and expand() builds
+         * the nodes for the parse tree.
+         */
+        template<typename Operand, typename... Levels>
+        struct Precedence : public _internal::Precedence
+        {
+            static_assert(sizeof...(Levels) > 0, "no operator levels");
+
+            /*
+             * What follows an operand ending at a position in the pika
+             * engine: the operators binding at least as tight as level L,
+             * each with its right operand. An entry holds the first
+             * operator, the operand after it, the Tail entry continuing
+             * that operand into the right operand, or null, and the entry
+             * of Tail<L> where the right operand ends, if any; its
+             * sub_fst_idx is the operator's level. Matched at the columns of
+             * the operators, so that every column only looks up entries of
+             * the columns to its right.
+             */
+            template<size_t L>
+            struct Tail : public _internal::NonTerminal
+            {
+                static_assert(L < sizeof...(Levels), "no such level");
+
+                PIKA_DEFAULT_INSTANCE;
+
+                DISPLAY({
+                    static std::string CLAUSE_LABEL = {};
+                    static bool INIT = false;
+                    if (!INIT)
+                    {
+                        INIT = true;
+                        auto dis = Precedence().display();
+                        CLAUSE_LABEL.append("TAIL( ")
+                            .append(dis.begin(), dis.end())
+                            .append(" ; ")
+                            .append(std::to_string(L))
+                            .append(" )");
+                    }
+                    return CLAUSE_LABEL;
+                })
+
+                void dfs_traversal(
+                    absl::flat_hash_set<std::type_index>& visited,
+                    std::vector<const Clause*>& terminals,
+                    std::vector<const Clause*>& nodes) const override;
+                void mark_seeds(pika::graph::ClauseTable& table) const override;
+                void sub_clauses(
+                    std::vector<const Clause*>& output) const override;
+                [[nodiscard]] analysis::FirstSet
+                first_set(const analysis::Analysis& analysis) const override;
+                void pika_match(pika::graph::ClauseTable& table) const override;
+            };
+
+            PIKA_DEFAULT_INSTANCE;
+
+            void dump_inner(
+                std::ostream& output,
+                absl::flat_hash_set<std::type_index>& visited) const override
+            {
+                if (!this->label() || visited.contains(typeid(*this)))
+                {
+                    return;
+                }
+                visited.insert(typeid(*this));
+                Operand().dump_inner(output, visited);
+                (Levels().dump_inner(output, visited), ...);
+                output << this->label().value() << " <- " << display()
+                       << std::endl;
+            }
+
+            DISPLAY({
+                static std::string CLAUSE_LABEL = {};
+                static bool INIT = false;
+                if (!INIT)
+                {
+                    INIT = true;
+                    auto append = [](const Clause& clause) {
+                        if (auto res = clause.label())
+                        {
+                            CLAUSE_LABEL.append(
+                                res.value().begin(), res.value().end());
+                        }
+                        else
+                        {
+                            auto dis = clause.display();
+                            CLAUSE_LABEL.append(dis.begin(), dis.end());
+                        }
+                    };
+                    CLAUSE_LABEL.append("PRECEDENCE( ");
+                    append(Operand());
+                    ((CLAUSE_LABEL.append(" ; "), append(Levels())), ...);
+                    CLAUSE_LABEL.append(" )");
+                }
+                return CLAUSE_LABEL;
+            })
+
+            std::shared_ptr<pika::memotable::Match> packrat_match(
+                pika::memotable::MemoTable& table, size_t index) const override;
+            void dfs_traversal(
+                absl::flat_hash_set<std::type_index>& visited,
+                std::vector<const Clause*>& terminals,
+                std::vector<const Clause*>& nodes) const override;
+            void mark_seeds(pika::graph::ClauseTable& table) const override;
+            void sub_clauses(
+                std::vector<const Clause*>& output) const override;
+            [[nodiscard]] analysis::FirstSet
+            first_set(const analysis::Analysis& analysis) const override;
+            void pika_match(pika::graph::ClauseTable& table) const override;
+
+            [[nodiscard]] std::shared_ptr<pika::memotable::Match> expand(
+                const pika::memotable::Match& match,
+                size_t position,
+                pika::memotable::MemoTable& scratch) const override;
+
+            /*
+             * The longest expression at `start` whose operators bind at
+             * least as tight as `level`, matched by the packrat engine.
+             */
+            std::shared_ptr<pika::memotable::Match> climb(
+                pika::memotable::MemoTable& table,
+                size_t start,
+                size_t level) const;
+
+            /*
+             * The nodes of `operand` at `start` followed by the chain of
+             * Tail entries `tail`, built in `table`.
+             */
+            std::shared_ptr<pika::memotable::Match> fold(
+                const std::shared_ptr<pika::memotable::Match>& operand,
+                const pika::memotable::Match* tail,
+                size_t start,
+                pika::memotable::MemoTable& table) const;
+
+            /*
+             * The instances of Tail<0> to Tail<N-1>, by level.
+             */
+            static std::array<const Clause*, sizeof...(Levels)> tails();
+            template<size_t... L>
+            static std::array<const Clause*, sizeof...(Levels)>
+            tails(std::index_sequence<L...>);
+        };
     }
 
 } // namespace pika::clause
 
+/*
+ * Turn string literals into their clauses for PIKA_STRING, PIKA_CHAR_SET
+ * and PIKA_KEYWORDS; only used in unevaluated context. Relies on the GNU
+ * string literal operator templates, like the rest of the library relies on
+ * typeof.
+ */
+template<typename T, T... Cs>
+pika::clause::String<Cs...> operator""_pika_string();
+
+template<typename T, T... Cs>
+pika::clause::CharSet<Cs...> operator""_pika_char_set();
+
+template<typename T, T... Cs>
+pika::clause::Keywords<Cs...> operator""_pika_keywords();
+
+/*
+ * The members shared by the rules of PIKA_DECLARE and
+ * PIKA_DECLARE_UNMEMOIZED.
+ */
+#define PIKA_DECLARED_RULE(TYPE_NAME, ACTIVE) \
+    PIKA_DEFAULT_INSTANCE; \
+    [[nodiscard]] std::optional<std::string_view> label() const override \
+    { \
+        return #TYPE_NAME; \
+    } \
+    [[nodiscard]] bool active() const override \
+    { \
+        return ACTIVE; \
+    }
+
 #define PIKA_DECLARE(TYPE_NAME, RULE, ACTIVE) \
     struct TYPE_NAME : RULE \
     { \
-        PIKA_DEFAULT_INSTANCE; \
-        [[nodiscard]] std::optional<std::string_view> label() const override \
+        PIKA_DECLARED_RULE(TYPE_NAME, ACTIVE) \
+    }
+
+#define PIKA_DECLARE_UNMEMOIZED(TYPE_NAME, RULE, ACTIVE) \
+    struct TYPE_NAME : RULE \
+    { \
+        PIKA_DECLARED_RULE(TYPE_NAME, ACTIVE) \
+        [[nodiscard]] bool memoizable() const override \
         { \
-            return #TYPE_NAME; \
+            return false; \
         } \
-        [[nodiscard]] bool active() const override \
-        { \
-            return ACTIVE; \
-        }; \
     }
 
 #define PIKA_ANY pika::clause::Any
 #define PIKA_NOTHING pika::clause::Nothing
 #define PIKA_FIRST pika::clause::First
+#define PIKA_CUT pika::clause::Cut
 #define PIKA_CHAR(C) pika::clause::Char<C>
 #define PIKA_CHAR_RANGE(A, B) pika::clause::CharRange<A, B>
+#define PIKA_STRING(S) decltype(S##_pika_string)
+#define PIKA_CHAR_SET(S) decltype(S##_pika_char_set)
+#define PIKA_KEYWORDS(S) decltype(S##_pika_keywords)
 #define PIKA_SEQ(...) pika::clause::Seq<__VA_ARGS__>
 #define PIKA_ORD(...) pika::clause::Ord<__VA_ARGS__>
 #define PIKA_PLUS(C) pika::clause::Plus<C>
 #define PIKA_OPTIONAL(C) pika::clause::Optional<C>
 #define PIKA_ASTERISKS(C) pika::clause::Asterisks<C>
+#define PIKA_REPEAT(C, MIN, MAX) pika::clause::Repeat<C, MIN, MAX>
 #define PIKA_FOLLOWED_BY(C) pika::clause::FollowedBy<C>
 #define PIKA_NOT_FOLLOWED_BY(C) pika::clause::NotFollowedBy<C>
-#ifdef PACKRAT_DEBUG
-#    include <iostream>
-#    define PACKRAT_DEBUG \
-        std::cout << "parsing: " \
-                  << (this->label() ? this->label().value() : this->display()) \
-                  << ", from: " << index << std::endl;
-#else
-#    define PACKRAT_DEBUG
-#endif
+#define PIKA_LEFT(OP) pika::clause::Infix<OP, false>
+#define PIKA_RIGHT(OP) pika::clause::Infix<OP, true>
+#define PIKA_PRECEDENCE(...) pika::clause::Precedence<__VA_ARGS__>
 #define PIKA_CHECKED_MATCH(BLOCK) \
-    PACKRAT_DEBUG \
-    auto key = pika::memotable::MemoKey(this->get_instance(), index); \
-    if (table.template contains(key)) \
-    { \
-        return table[key]; \
-    } \
-    { \
-        BLOCK \
-    } \
-    return table[key] = nullptr
+    return table.packrat_memoize( \
+        this->clause_id(), \
+        index, \
+        [&]() -> std::shared_ptr<pika::memotable::Match> { \
+            PIKA_STATISTIC(table, this->get_instance(), evaluations); \
+            pika::trace::Scope trace_scope(table.tracer, this, index); \
+            BLOCK \
+            return nullptr; \
+        })
 #endif // PIKA_CLAUSE_HPP
\ No newline at end of file
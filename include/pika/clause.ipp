@@ -1,6 +1,8 @@
 #ifndef PIKA_CLAUSE_IPP
 #define PIKA_CLAUSE_IPP
 
+#include <absl/container/inlined_vector.h>
+#include <pika/analysis.hpp>
 #include <pika/clause.hpp>
 #include <pika/graph.hpp>
 #include <pika/memotable.hpp>
@@ -13,11 +15,10 @@ std::shared_ptr<pika::memotable::Match> pika::clause::Char<C>::packrat_match(
     PIKA_CHECKED_MATCH({
         if (!table.at_end(index) && table.get_char(index) == C)
         {
-            return table[key] = std::make_shared<pika::memotable::Match>(
-                       key,
-                       1,
-                       0,
-                       std::vector<std::shared_ptr<pika::memotable::Match>>{});
+            return table.make_match(
+                pika::memotable::MemoKey(this->get_instance(), index),
+                1,
+                0);
         }
     });
 }
@@ -25,12 +26,21 @@ std::shared_ptr<pika::memotable::Match> pika::clause::Char<C>::packrat_match(
 template<char C>
 void pika::clause::Char<C>::pika_match(pika::graph::ClauseTable& table) const
 {
-    if (table.get_current() == C)
+    if (!table.eof() && table.get_current() == C)
     {
         table.try_add(this->get_instance(), 1, 0, {});
     }
 }
 
+template<char C>
+pika::analysis::FirstSet
+pika::clause::Char<C>::first_set(const analysis::Analysis&) const
+{
+    analysis::SymbolSet symbols;
+    symbols.set(static_cast<unsigned char>(C));
+    return analysis::FirstSet::terminal(symbols);
+}
+
 template<char Start, char End>
 std::shared_ptr<pika::memotable::Match>
 pika::clause::CharRange<Start, End>::packrat_match(
@@ -40,11 +50,10 @@ pika::clause::CharRange<Start, End>::packrat_match(
         if (!table.at_end(index) && table.get_char(index) >= Start &&
             table.get_char(index) <= End)
         {
-            return table[key] = std::make_shared<pika::memotable::Match>(
-                       key,
-                       1,
-                       0,
-                       std::vector<std::shared_ptr<pika::memotable::Match>>{});
+            return table.make_match(
+                pika::memotable::MemoKey(this->get_instance(), index),
+                1,
+                0);
         }
     });
 }
@@ -54,25 +63,42 @@ void pika::clause::CharRange<Start, End>::pika_match(
     pika::graph::ClauseTable& table) const
 {
     auto current = table.get_current();
-    if (current >= Start && current <= End)
+    if (!table.eof() && current >= Start && current <= End)
     {
         table.try_add(this->get_instance(), 1, 0, {});
     }
 }
 
+template<char Start, char End>
+pika::analysis::FirstSet pika::clause::CharRange<Start, End>::first_set(
+    const analysis::Analysis&) const
+{
+    /*
+     * Matching compares plain chars, so the range is walked the same way.
+     */
+    analysis::SymbolSet symbols;
+    for (int i = Start; i <= End; ++i)
+    {
+        symbols.set(static_cast<unsigned char>(i));
+    }
+    return analysis::FirstSet::terminal(symbols);
+}
+
 template<typename S>
 std::shared_ptr<pika::memotable::Match>
 pika::clause::NotFollowedBy<S>::packrat_match(
     memotable::MemoTable& table, size_t index) const
 {
     PIKA_CHECKED_MATCH({
-        if (!S().packrat_match(table, index))
+        table.packrat_enter(index);
+        auto res = S().packrat_match(table, index);
+        table.packrat_leave();
+        if (!res)
         {
-            return table[key] = std::make_shared<pika::memotable::Match>(
-                       key,
-                       0,
-                       0,
-                       std::vector<std::shared_ptr<pika::memotable::Match>>{});
+            return table.make_match(
+                pika::memotable::MemoKey(this->get_instance(), index),
+                0,
+                0);
         }
     });
 }
@@ -83,14 +109,16 @@ pika::clause::FollowedBy<S>::packrat_match(
     memotable::MemoTable& table, size_t index) const
 {
     PIKA_CHECKED_MATCH({
-        if (auto res = S().packrat_match(table, index))
+        table.packrat_enter(index);
+        auto res = S().packrat_match(table, index);
+        table.packrat_leave();
+        if (res)
         {
-            return table[key] = std::make_shared<pika::memotable::Match>(
-                       key,
-                       0,
-                       0,
-                       std::vector<std::shared_ptr<pika::memotable::Match>>{
-                           res});
+            return table.make_match(
+                pika::memotable::MemoKey(this->get_instance(), index),
+                0,
+                0,
+                absl::MakeSpan(&res, 1));
         }
     });
 }
@@ -101,22 +129,26 @@ pika::clause::Optional<S>::packrat_match(
     memotable::MemoTable& table, size_t index) const
 {
     PIKA_CHECKED_MATCH({
-        if (auto res = S().packrat_match(table, index))
+        table.packrat_enter(index);
+        auto res = S().packrat_match(table, index);
+        if (table.packrat_leave() && !res)
         {
-            return table[key] = std::make_shared<pika::memotable::Match>(
-                       key,
-                       res->get_length(),
-                       0,
-                       std::vector<std::shared_ptr<pika::memotable::Match>>{
-                           res});
+            return nullptr;
+        }
+        if (res)
+        {
+            return table.make_match(
+                pika::memotable::MemoKey(this->get_instance(), index),
+                res->get_length(),
+                0,
+                absl::MakeSpan(&res, 1));
         }
         else
         {
-            return table[key] = std::make_shared<pika::memotable::Match>(
-                       key,
-                       0,
-                       0,
-                       std::vector<std::shared_ptr<pika::memotable::Match>>{});
+            return table.make_match(
+                pika::memotable::MemoKey(this->get_instance(), index),
+                0,
+                0);
         }
     });
 }
@@ -126,19 +158,30 @@ std::shared_ptr<pika::memotable::Match>
 pika::clause::Asterisks<S>::packrat_match(
     memotable::MemoTable& table, size_t index) const
 {
+    using Buffer =
+        absl::InlinedVector<std::shared_ptr<pika::memotable::Match>, 2>;
     PIKA_CHECKED_MATCH({
         size_t matched_length = 0;
         S inner{};
-        std::vector<std::shared_ptr<pika::memotable::Match>> sub_matches{};
+        Buffer sub_matches;
+        table.packrat_enter(index);
         while (auto res = inner.packrat_match(table, index + matched_length))
         {
             matched_length += res->get_length();
             sub_matches.push_back(res);
+            table.packrat_restart(index + matched_length);
             if (res->get_length() == 0)
                 break;
         }
-        return table[key] = std::make_shared<pika::memotable::Match>(
-                   key, matched_length, 0, std::move(sub_matches));
+        if (table.packrat_leave())
+        {
+            return nullptr;
+        }
+        return table.make_match(
+            pika::memotable::MemoKey(this->get_instance(), index),
+            matched_length,
+            0,
+            absl::MakeSpan(sub_matches));
     }
 
     );
@@ -148,25 +191,164 @@ template<typename S>
 std::shared_ptr<pika::memotable::Match> pika::clause::Plus<S>::packrat_match(
     memotable::MemoTable& table, size_t index) const
 {
+    using Buffer =
+        absl::InlinedVector<std::shared_ptr<pika::memotable::Match>, 2>;
     PIKA_CHECKED_MATCH({
         size_t matched_length = 0;
         S inner{};
-        std::vector<std::shared_ptr<pika::memotable::Match>> sub_matches{};
+        Buffer sub_matches;
+        table.packrat_enter(index);
         while (auto res = inner.packrat_match(table, index + matched_length))
         {
             matched_length += res->get_length();
             sub_matches.push_back(res);
+            table.packrat_restart(index + matched_length);
             if (res->get_length() == 0)
                 break;
         }
+        if (table.packrat_leave())
+        {
+            return nullptr;
+        }
         if (!sub_matches.empty())
-            return table[key] = std::make_shared<pika::memotable::Match>(
-                       key, matched_length, 0, std::move(sub_matches));
+            return table.make_match(
+                pika::memotable::MemoKey(this->get_instance(), index),
+                matched_length,
+                0,
+                absl::MakeSpan(sub_matches));
     }
 
     );
 }
 
+template<char... Cs>
+std::shared_ptr<pika::memotable::Match>
+pika::clause::String<Cs...>::packrat_match(
+    memotable::MemoTable& table, size_t index) const
+{
+    PIKA_CHECKED_MATCH({
+        if (table.matches(index, {VALUE, sizeof...(Cs)}))
+        {
+            return table.make_match(
+                pika::memotable::MemoKey(this->get_instance(), index),
+                sizeof...(Cs),
+                0);
+        }
+    });
+}
+
+template<char... Cs>
+void pika::clause::String<Cs...>::pika_match(
+    pika::graph::ClauseTable& table) const
+{
+    table.extend_reach(sizeof...(Cs));
+    if (table.memo_table.matches(
+            table.current_pos - 1, {VALUE, sizeof...(Cs)}))
+    {
+        table.try_add(this->get_instance(), sizeof...(Cs), 0, {});
+    }
+}
+
+template<char... Cs>
+pika::analysis::FirstSet pika::clause::String<Cs...>::first_set(
+    const analysis::Analysis&) const
+{
+    if constexpr (sizeof...(Cs) == 0)
+    {
+        return analysis::FirstSet::lookahead(~analysis::SymbolSet{});
+    }
+    else
+    {
+        analysis::SymbolSet symbols;
+        symbols.set(static_cast<unsigned char>(VALUE[0]));
+        auto result = analysis::FirstSet::terminal(symbols);
+        result.exact = sizeof...(Cs) == 1;
+        return result;
+    }
+}
+
+template<char... Cs>
+std::shared_ptr<pika::memotable::Match>
+pika::clause::CharSet<Cs...>::packrat_match(
+    memotable::MemoTable& table, size_t index) const
+{
+    PIKA_CHECKED_MATCH({
+        if (!table.at_end(index) && contains(table.get_char(index)))
+        {
+            return table.make_match(
+                pika::memotable::MemoKey(this->get_instance(), index),
+                1,
+                0);
+        }
+    });
+}
+
+template<char... Cs>
+void pika::clause::CharSet<Cs...>::pika_match(
+    pika::graph::ClauseTable& table) const
+{
+    if (!table.eof() && contains(table.get_current()))
+    {
+        table.try_add(this->get_instance(), 1, 0, {});
+    }
+}
+
+template<char... Cs>
+pika::analysis::FirstSet pika::clause::CharSet<Cs...>::first_set(
+    const analysis::Analysis&) const
+{
+    analysis::SymbolSet symbols;
+    for (size_t i = 0; i < 256; ++i)
+    {
+        symbols[i] = MEMBERS[i / 64] >> (i % 64) & 1;
+    }
+    return analysis::FirstSet::terminal(symbols);
+}
+
+template<char... Cs>
+std::shared_ptr<pika::memotable::Match>
+pika::clause::Keywords<Cs...>::packrat_match(
+    memotable::MemoTable& table, size_t index) const
+{
+    PIKA_CHECKED_MATCH({
+        auto found = TRIE.match(table.rest(index));
+        if (found.first != TRIE.NONE)
+        {
+            return table.make_match(
+                pika::memotable::MemoKey(this->get_instance(), index),
+                found.second,
+                found.first);
+        }
+    });
+}
+
+template<char... Cs>
+void pika::clause::Keywords<Cs...>::pika_match(
+    pika::graph::ClauseTable& table) const
+{
+    table.extend_reach(TRIE.longest + 1);
+    auto found = TRIE.match(table.memo_table.rest(table.current_pos - 1));
+    if (found.first != TRIE.NONE)
+    {
+        table.try_add(this->get_instance(), found.second, found.first, {});
+    }
+}
+
+template<char... Cs>
+pika::analysis::FirstSet pika::clause::Keywords<Cs...>::first_set(
+    const analysis::Analysis&) const
+{
+    analysis::SymbolSet symbols;
+    for (auto i = TRIE.nodes[0].first_child; i != TRIE.NONE;
+         i = TRIE.nodes[i].next_sibling)
+    {
+        symbols.set(static_cast<unsigned char>(TRIE.nodes[i].label));
+    }
+    auto result = analysis::FirstSet::terminal(symbols);
+    result.exact = false;
+    return result;
+}
+
 template<typename S>
 void pika::clause::Plus<S>::dfs_traversal(
     absl::flat_hash_set<std::type_index>& visited,
@@ -182,33 +364,49 @@ void pika::clause::Plus<S>::mark_seeds(pika::graph::ClauseTable& table) const
     table.at(typeid(S)).candidates.push_back(this->get_instance());
 }
 
+template<typename S>
+void pika::clause::Plus<S>::sub_clauses(
+    std::vector<const Clause*>& output) const
+{
+    output.push_back(S().get_instance());
+}
+
+template<typename S>
+pika::analysis::FirstSet pika::clause::Plus<S>::first_set(
+    const analysis::Analysis& analysis) const
+{
+    auto result = analysis[S()];
+    result.exact = false;
+    return result;
+}
+
 template<typename S>
 void pika::clause::Plus<S>::pika_match(pika::graph::ClauseTable& table) const
 {
-    std::vector<std::shared_ptr<memotable::Match>> sub_matches;
+    /*
+     * Holds the match of the element and of the repetition after it.
+     */
+    absl::InlinedVector<std::shared_ptr<memotable::Match>, 2> sub_matches;
     size_t length = 0;
-    auto target = table.memo_table.template find(
-        {S().get_instance(), table.current_pos - 1 + length});
+    auto target = table.lookup(S().get_instance(), length);
     while (target != table.memo_table.end())
     {
         sub_matches.push_back(target->second);
         if (target->second->length == 0)
             break;
         length += target->second->length;
-        auto reduced = table.memo_table.template find(
-            {this->get_instance(), table.current_pos - 1 + length});
+        auto reduced = table.lookup(this->get_instance(), length);
         if (reduced != table.memo_table.end())
         {
             length += reduced->second->length;
             sub_matches.push_back(reduced->second);
             break;
         }
-        target = table.memo_table.template find(
-            {S().get_instance(), table.current_pos - 1 + length});
+        target = table.lookup(S().get_instance(), length);
     }
     if (!sub_matches.empty())
     {
-        table.try_add(this->get_instance(), length, 0, std::move(sub_matches));
+        table.try_add(this->get_instance(), length, 0, sub_matches);
     }
 }
 
@@ -228,32 +426,213 @@ void pika::clause::Asterisks<S>::mark_seeds(
     table.at(typeid(S)).candidates.push_back(this->get_instance());
 }
 
+template<typename S>
+void pika::clause::Asterisks<S>::sub_clauses(
+    std::vector<const Clause*>& output) const
+{
+    output.push_back(S().get_instance());
+}
+
+template<typename S>
+pika::analysis::FirstSet pika::clause::Asterisks<S>::first_set(
+    const analysis::Analysis& analysis) const
+{
+    auto result = analysis::FirstSet::lookahead(~analysis::SymbolSet{});
+    result.consuming = analysis[S()].consuming;
+    return result;
+}
+
 template<typename S>
 void pika::clause::Asterisks<S>::pika_match(
     pika::graph::ClauseTable& table) const
 {
-    std::vector<std::shared_ptr<memotable::Match>> sub_matches;
+    absl::InlinedVector<std::shared_ptr<memotable::Match>, 2> sub_matches;
     size_t length = 0;
-    auto target = table.memo_table.template find(
-        {S().get_instance(), table.current_pos - 1 + length});
+    auto target = table.lookup(S().get_instance(), length);
     while (target != table.memo_table.end())
     {
         sub_matches.push_back(target->second);
         if (target->second->length == 0)
             break;
         length += target->second->length;
-        auto reduced = table.memo_table.template find(
-            {this->get_instance(), table.current_pos - 1 + length});
+        auto reduced = table.lookup(this->get_instance(), length);
         if (reduced != table.memo_table.end())
         {
             length += reduced->second->length;
             sub_matches.push_back(reduced->second);
             break;
         }
-        target = table.memo_table.template find(
-            {S().get_instance(), table.current_pos - 1 + length});
+        target = table.lookup(S().get_instance(), length);
+    }
+    table.try_add(this->get_instance(), length, 0, sub_matches);
+}
+
+template<typename S, size_t Min, size_t Max>
+size_t pika::clause::Repeat<S, Min, Max>::scan(
+    const memotable::MemoTable& table, size_t index)
+{
+    size_t count = 0;
+    while (count < Max && !table.at_end(index + count) &&
+           S::contains(table.get_char(index + count)))
+    {
+        count += 1;
+    }
+    return count;
+}
+
+template<typename S, size_t Min, size_t Max>
+typename pika::clause::Repeat<S, Min, Max>::Buffer
+pika::clause::Repeat<S, Min, Max>::scanned(
+    memotable::MemoTable& table, size_t index, size_t count)
+{
+    Buffer sub_matches;
+    S inner{};
+    if (inner.active())
+    {
+        sub_matches.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            sub_matches.push_back(table.make_match(
+                memotable::MemoKey(
+                    inner.get_instance(), table.key_position(index + i)),
+                1,
+                0));
+        }
+    }
+    return sub_matches;
+}
+
+template<typename S, size_t Min, size_t Max>
+std::shared_ptr<pika::memotable::Match>
+pika::clause::Repeat<S, Min, Max>::packrat_match(
+    memotable::MemoTable& table, size_t index) const
+{
+    PIKA_CHECKED_MATCH({
+        size_t matched_length = 0;
+        size_t count = 0;
+        Buffer sub_matches;
+        if constexpr (_internal::ByteClass<S>::value)
+        {
+            count = matched_length = scan(table, index);
+            if (count < Min)
+            {
+                return nullptr;
+            }
+            sub_matches = scanned(table, index, count);
+        }
+        else
+        {
+            S inner{};
+            table.packrat_enter(index);
+            while (count < Max)
+            {
+                auto res = inner.packrat_match(table, index + matched_length);
+                if (!res)
+                {
+                    break;
+                }
+                matched_length += res->get_length();
+                sub_matches.push_back(res);
+                table.packrat_restart(index + matched_length);
+                /*
+                 * An empty match would repeat forever, so it satisfies any
+                 * count.
+                 */
+                count = res->get_length() == 0 ? Max : count + 1;
+            }
+            if (table.packrat_leave())
+            {
+                return nullptr;
+            }
+        }
+        if (count >= Min)
+        {
+            return table.make_match(
+                pika::memotable::MemoKey(this->get_instance(), index),
+                matched_length,
+                0,
+                absl::MakeSpan(sub_matches));
+        }
+    });
+}
+
+template<typename S, size_t Min, size_t Max>
+void pika::clause::Repeat<S, Min, Max>::dfs_traversal(
+    absl::flat_hash_set<std::type_index>& visited,
+    std::vector<const Clause*>& terminals,
+    std::vector<const Clause*>& nodes) const
+{
+    PIKA_DFS_UNARY(S)
+}
+
+template<typename S, size_t Min, size_t Max>
+void pika::clause::Repeat<S, Min, Max>::mark_seeds(
+    pika::graph::ClauseTable& table) const
+{
+    table.at(typeid(S)).candidates.push_back(this->get_instance());
+}
+
+template<typename S, size_t Min, size_t Max>
+void pika::clause::Repeat<S, Min, Max>::sub_clauses(
+    std::vector<const Clause*>& output) const
+{
+    output.push_back(S().get_instance());
+}
+
+template<typename S, size_t Min, size_t Max>
+pika::analysis::FirstSet pika::clause::Repeat<S, Min, Max>::first_set(
+    const analysis::Analysis& analysis) const
+{
+    if (Min == 0)
+    {
+        auto result = analysis::FirstSet::lookahead(~analysis::SymbolSet{});
+        result.consuming = analysis[S()].consuming;
+        return result;
+    }
+    auto result = analysis[S()];
+    result.exact = false;
+    return result;
+}
+
+template<typename S, size_t Min, size_t Max>
+void pika::clause::Repeat<S, Min, Max>::pika_match(
+    pika::graph::ClauseTable& table) const
+{
+    size_t length = 0;
+    size_t count = 0;
+    Buffer sub_matches;
+    if constexpr (_internal::ByteClass<S>::value)
+    {
+        auto index = table.current_pos - 1;
+        count = length = scan(table.memo_table, index);
+        /*
+         * A scan stopped short of Max has also looked at the byte after.
+         */
+        table.extend_reach(count < Max ? count + 1 : count);
+        if (count < Min || !table.improves(this->get_instance(), length, 0))
+        {
+            return;
+        }
+        sub_matches = scanned(table.memo_table, index, count);
+    }
+    else
+    {
+        while (count < Max)
+        {
+            auto target = table.lookup(S().get_instance(), length);
+            if (target == table.memo_table.end())
+            {
+                break;
+            }
+            sub_matches.push_back(target->second);
+            length += target->second->length;
+            count = target->second->length == 0 ? Max : count + 1;
+        }
+    }
+    if (count >= Min)
+    {
+        table.try_add(this->get_instance(), length, 0, sub_matches);
     }
-    table.try_add(this->get_instance(), length, 0, std::move(sub_matches));
 }
 
 template<typename S>
@@ -272,20 +651,39 @@ void pika::clause::Optional<S>::mark_seeds(
     table.at(typeid(S)).candidates.push_back(this->get_instance());
 }
 
+template<typename S>
+void pika::clause::Optional<S>::sub_clauses(
+    std::vector<const Clause*>& output) const
+{
+    output.push_back(S().get_instance());
+}
+
+template<typename S>
+pika::analysis::FirstSet pika::clause::Optional<S>::first_set(
+    const analysis::Analysis& analysis) const
+{
+    auto result = analysis::FirstSet::lookahead(~analysis::SymbolSet{});
+    result.consuming = analysis[S()].consuming;
+    return result;
+}
+
 template<typename S>
 void pika::clause::Optional<S>::pika_match(
     pika::graph::ClauseTable& table) const
 {
-    std::vector<std::shared_ptr<memotable::Match>> sub_matches;
-    size_t length = 0;
-    auto target = table.memo_table.template find(
-        {S().get_instance(), table.current_pos - 1 + length});
+    auto target = table.lookup(S().get_instance(), 0);
     if (target != table.memo_table.end())
     {
-        sub_matches.push_back(target->second);
-        length += target->second->length;
+        table.try_add(
+            this->get_instance(),
+            target->second->length,
+            0,
+            {&target->second, 1});
+    }
+    else
+    {
+        table.try_add(this->get_instance(), 0, 0, {});
     }
-    table.try_add(this->get_instance(), length, 0, std::move(sub_matches));
 }
 
 template<typename S>
@@ -304,12 +702,25 @@ void pika::clause::FollowedBy<S>::mark_seeds(
     table.at(typeid(S)).candidates.push_back(this->get_instance());
 }
 
+template<typename S>
+void pika::clause::FollowedBy<S>::sub_clauses(
+    std::vector<const Clause*>& output) const
+{
+    output.push_back(S().get_instance());
+}
+
+template<typename S>
+pika::analysis::FirstSet pika::clause::FollowedBy<S>::first_set(
+    const analysis::Analysis& analysis) const
+{
+    return analysis::FirstSet::lookahead(analysis[S()].first);
+}
+
 template<typename S>
 void pika::clause::FollowedBy<S>::pika_match(
     pika::graph::ClauseTable& table) const
 {
-    if (table.memo_table.template contains(
-            {S().get_instance(), table.current_pos - 1}))
+    if (table.lookup(S().get_instance(), 0) != table.memo_table.end())
     {
         table.try_add(this->get_instance(), 0, 0, {});
     }
@@ -331,44 +742,102 @@ void pika::clause::NotFollowedBy<S>::mark_seeds(
     table.at(typeid(S)).candidates.push_back(this->get_instance());
 }
 
+template<typename S>
+void pika::clause::NotFollowedBy<S>::sub_clauses(
+    std::vector<const Clause*>& output) const
+{
+    output.push_back(S().get_instance());
+}
+
+template<typename S>
+pika::analysis::FirstSet pika::clause::NotFollowedBy<S>::first_set(
+    const analysis::Analysis& analysis) const
+{
+    /*
+     * Only the complement of an exact set is known to be safe.
+     */
+    auto child = analysis[S()];
+    return analysis::FirstSet::lookahead(
+        child.exact ? ~child.first : ~analysis::SymbolSet{});
+}
+
 template<typename S>
 void pika::clause::NotFollowedBy<S>::pika_match(
     pika::graph::ClauseTable& table) const
 {
-    if (!table.memo_table.template contains(
-            {S().get_instance(), table.current_pos - 1}))
+    if (table.lookup(S().get_instance(), 0) == table.memo_table.end())
     {
         table.try_add(this->get_instance(), 0, 0, {});
     }
 }
 
-template<typename S>
-std::shared_ptr<pika::memotable::Match> pika::clause::Ord<S>::packrat_match(
+template<typename H>
+std::shared_ptr<pika::memotable::Match> pika::clause::Ord<H>::packrat_match(
     memotable::MemoTable& table, size_t index) const
 {
-    PIKA_CHECKED_MATCH(if (auto res = S().packrat_match(table, index)) {
-        return table[key] = std::make_shared<pika::memotable::Match>(
-                   key,
-                   res->get_length(),
-                   0,
-                   std::vector<std::shared_ptr<pika::memotable::Match>>{res});
+    PIKA_CHECKED_MATCH({
+        table.packrat_enter(index);
+        auto res = packrat_match_unchecked(table, index, 0);
+        table.packrat_leave();
+        return res;
     });
 }
 
+template<typename H>
+std::shared_ptr<pika::memotable::Match>
+pika::clause::Ord<H>::packrat_match_unchecked(
+    memotable::MemoTable& table, size_t index, size_t order) const
+{
+    if (!table.packrat_viable(H().clause_id(), index))
+    {
+        return nullptr;
+    }
+    if (auto res = H().packrat_match(table, index))
+    {
+        return table.make_match(
+            pika::memotable::MemoKey(this->get_instance(), index),
+            res->get_length(),
+            order,
+            absl::MakeSpan(&res, 1));
+    }
+    return nullptr;
+}
+
 template<typename H, typename... T>
 std::shared_ptr<pika::memotable::Match>
 pika::clause::Ord<H, T...>::packrat_match(
     memotable::MemoTable& table, size_t index) const
 {
-    PIKA_CHECKED_MATCH(
-        if (auto res = H().packrat_match(table, index)) {
-            return table[key] = std::make_shared<pika::memotable::Match>(
-                       key,
-                       res->get_length(),
-                       0,
-                       std::vector<std::shared_ptr<pika::memotable::Match>>{
-                           res});
-        } else { return Ord<T...>::packrat_match(table, index); });
+    PIKA_CHECKED_MATCH({
+        table.packrat_enter(index);
+        auto res = packrat_match_unchecked(table, index, 0);
+        table.packrat_leave();
+        return res;
+    });
+}
+
+template<typename H, typename... T>
+std::shared_ptr<pika::memotable::Match>
+pika::clause::Ord<H, T...>::packrat_match_unchecked(
+    memotable::MemoTable& table, size_t index, size_t order) const
+{
+    if (!table.packrat_viable(H().clause_id(), index))
+    {
+        return Ord<T...>::packrat_match_unchecked(table, index, order + 1);
+    }
+    if (auto res = H().packrat_match(table, index))
+    {
+        return table.make_match(
+            pika::memotable::MemoKey(this->get_instance(), index),
+            res->get_length(),
+            order,
+            absl::MakeSpan(&res, 1));
+    }
+    if (table.packrat_committed())
+    {
+        return nullptr;
+    }
+    return Ord<T...>::packrat_match_unchecked(table, index, order + 1);
 }
 
 template<typename H, typename... T>
@@ -377,16 +846,17 @@ pika::clause::Seq<H, T...>::packrat_reduce(
     memotable::MemoTable& table,
     size_t index,
     size_t length,
-    std::vector<std::shared_ptr<pika::memotable::Match>> collection) const
+    size_t base) const
 {
     if (auto res = H().packrat_match(table, index + length))
     {
-        collection.push_back(res);
-        return Seq<T...>::packrat_reduce(
-            table, index, length + res->get_length(), std::move(collection));
+        auto next = length + res->get_length();
+        table.packrat_push_operand(std::move(res));
+        return Seq<T...>::packrat_reduce(table, index, next, base);
     }
     else
     {
+        table.packrat_drop_operands(base);
         return nullptr;
     }
 }
@@ -396,17 +866,21 @@ std::shared_ptr<pika::memotable::Match> pika::clause::Seq<H>::packrat_reduce(
     memotable::MemoTable& table,
     size_t index,
     size_t length,
-    std::vector<std::shared_ptr<pika::memotable::Match>> collection) const
+    size_t base) const
 {
     if (auto res = H().packrat_match(table, index + length))
     {
         auto key = pika::memotable::MemoKey(this->get_instance(), index);
-        collection.push_back(res);
-        return std::make_shared<pika::memotable::Match>(
-            key, length + res->get_length(), 0, std::move(collection));
+        length += res->get_length();
+        table.packrat_push_operand(std::move(res));
+        auto match = table.make_match(
+            key, length, 0, table.packrat_top_operands(base));
+        table.packrat_drop_operands(base);
+        return match;
     }
     else
     {
+        table.packrat_drop_operands(base);
         return nullptr;
     }
 }
@@ -415,9 +889,10 @@ template<typename S>
 std::shared_ptr<pika::memotable::Match> pika::clause::Seq<S>::packrat_match(
     memotable::MemoTable& table, size_t index) const
 {
-    PIKA_CHECKED_MATCH({ return packrat_reduce(table, index, 0, {}); }
-
-    );
+    PIKA_CHECKED_MATCH({
+        return packrat_reduce(
+            table, index, 0, table.packrat_operand_count());
+    });
 }
 
 template<typename H, typename... T>
@@ -445,51 +920,69 @@ void pika::clause::Seq<H>::mark_seeds(pika::graph::ClauseTable& table) const
     table.at(typeid(H)).candidates.push_back(this->get_instance());
 }
 
+template<typename H>
+void pika::clause::Seq<H>::sub_clauses(
+    std::vector<const Clause*>& output) const
+{
+    output.push_back(H().get_instance());
+}
+
+template<typename H>
+pika::analysis::FirstSet pika::clause::Seq<H>::first_set(
+    const analysis::Analysis& analysis) const
+{
+    auto result = analysis[H()];
+    result.exact = false;
+    return result;
+}
+
 template<typename H, typename... T>
 void pika::clause::Seq<H, T...>::pika_match(
     pika::graph::ClauseTable& table) const
 {
-    pika_match_unchecked(table, 0, {});
+    Buffer matches;
+    pika_match_unchecked(table, 0, matches.data(), 0);
 }
 
 template<typename H, typename... T>
 void pika::clause::Seq<H, T...>::pika_match_unchecked(
     pika::graph::ClauseTable& table,
     size_t length,
-    std::vector<std::shared_ptr<memotable::Match>> matches) const
+    std::shared_ptr<memotable::Match>* matches,
+    size_t filled) const
 {
-    auto target = table.memo_table.template find(
-        {H().get_instance(), table.current_pos - 1 + length});
+    auto target = table.lookup(H().get_instance(), length);
     if (target != table.memo_table.end())
     {
-        matches.push_back(target->second);
+        matches[filled] = target->second;
         Seq<T...>::pika_match_unchecked(
-            table, length + target->second->length, std::move(matches));
+            table, length + target->second->length, matches, filled + 1);
     }
 }
 
 template<typename H>
 void pika::clause::Seq<H>::pika_match(pika::graph::ClauseTable& table) const
 {
-    pika_match_unchecked(table, 0, {});
+    Buffer matches;
+    pika_match_unchecked(table, 0, matches.data(), 0);
 }
 
 template<typename H>
 void pika::clause::Seq<H>::pika_match_unchecked(
     pika::graph::ClauseTable& table,
     size_t length,
-    std::vector<std::shared_ptr<memotable::Match>> matches) const
+    std::shared_ptr<memotable::Match>* matches,
+    size_t filled) const
 {
-    auto target = table.memo_table.template find(
-        {H().get_instance(), table.current_pos - 1 + length});
+    auto target = table.lookup(H().get_instance(), length);
     if (target != table.memo_table.end())
     {
-        matches.push_back(target->second);
+        matches[filled] = target->second;
         table.try_add(
             this->get_instance(),
             length + target->second->length,
             0,
-            std::move(matches));
+            {matches, filled + 1});
     }
 }
 
@@ -500,6 +993,21 @@ void pika::clause::Seq<H, T...>::mark_seeds(
     table.at(typeid(H)).candidates.push_back(this->get_instance());
 }
 
+template<typename H, typename... T>
+void pika::clause::Seq<H, T...>::sub_clauses(
+    std::vector<const Clause*>& output) const
+{
+    output.push_back(H().get_instance());
+    Seq<T...>::sub_clauses(output);
+}
+
+template<typename H, typename... T>
+pika::analysis::FirstSet pika::clause::Seq<H, T...>::first_set(
+    const analysis::Analysis& analysis) const
+{
+    return analysis[H()].then(Seq<T...>::first_set(analysis));
+}
+
 template<typename H>
 void pika::clause::Seq<H>::dfs_traversal(
     absl::flat_hash_set<std::type_index>& visited,
@@ -546,6 +1054,21 @@ void pika::clause::Ord<H, T...>::mark_seeds(
     Ord<T...>::mark_seeds(table);
 }
 
+template<typename H, typename... T>
+void pika::clause::Ord<H, T...>::sub_clauses(
+    std::vector<const Clause*>& output) const
+{
+    output.push_back(H().get_instance());
+    Ord<T...>::sub_clauses(output);
+}
+
+template<typename H, typename... T>
+pika::analysis::FirstSet pika::clause::Ord<H, T...>::first_set(
+    const analysis::Analysis& analysis) const
+{
+    return analysis[H()].otherwise(Ord<T...>::first_set(analysis));
+}
+
 template<typename H, typename... T>
 void pika::clause::Ord<H, T...>::pika_match(
     pika::graph::ClauseTable& table) const
@@ -557,15 +1080,14 @@ template<typename H, typename... T>
 void pika::clause::Ord<H, T...>::pika_match_unchecked(
     pika::graph::ClauseTable& table, size_t order) const
 {
-    auto target = table.memo_table.template find(
-        {H().get_instance(), table.current_pos - 1});
+    auto target = table.lookup(H().get_instance(), 0);
     if (target != table.memo_table.end())
     {
         table.try_add(
             this->get_instance(),
             target->second->length,
             order,
-            {target->second});
+            {&target->second, 1});
     }
     else
     {
@@ -583,15 +1105,14 @@ template<typename H>
 void pika::clause::Ord<H>::pika_match_unchecked(
     pika::graph::ClauseTable& table, size_t order) const
 {
-    auto target = table.memo_table.template find(
-        {H().get_instance(), table.current_pos - 1});
+    auto target = table.lookup(H().get_instance(), 0);
     if (target != table.memo_table.end())
     {
         table.try_add(
             this->get_instance(),
             target->second->length,
             order,
-            {target->second});
+            {&target->second, 1});
     }
 }
 
@@ -601,6 +1122,22 @@ void pika::clause::Ord<H>::mark_seeds(pika::graph::ClauseTable& table) const
     table.at(typeid(H)).candidates.push_back(this->get_instance());
 }
 
+template<typename H>
+void pika::clause::Ord<H>::sub_clauses(
+    std::vector<const Clause*>& output) const
+{
+    output.push_back(H().get_instance());
+}
+
+template<typename H>
+pika::analysis::FirstSet pika::clause::Ord<H>::first_set(
+    const analysis::Analysis& analysis) const
+{
+    auto result = analysis[H()];
+    result.exact = false;
+    return result;
+}
+
 template<typename H>
 void pika::clause::Ord<H>::dfs_traversal(
     absl::flat_hash_set<std::type_index>& visited,
@@ -620,12 +1157,367 @@ void pika::clause::Ord<H>::_dfs_traversal(
     nodes.push_back(this->get_instance());
 }
 
+template<typename Op, bool RightAssociative>
+void pika::clause::Infix<Op, RightAssociative>::dfs_traversal(
+    absl::flat_hash_set<std::type_index>& visited,
+    std::vector<const Clause*>& terminals,
+    std::vector<const Clause*>& nodes) const
+{
+    PIKA_DFS_UNARY(Op)
+}
+
+template<typename Op, bool RightAssociative>
+void pika::clause::Infix<Op, RightAssociative>::sub_clauses(
+    std::vector<const Clause*>& output) const
+{
+    output.push_back(Op().get_instance());
+}
+
+template<typename Op, bool RightAssociative>
+pika::analysis::FirstSet pika::clause::Infix<Op, RightAssociative>::first_set(
+    const analysis::Analysis& analysis) const
+{
+    auto result = analysis[Op()];
+    result.exact = false;
+    return result;
+}
+
+template<typename Op, bool RightAssociative>
+void pika::clause::Infix<Op, RightAssociative>::pika_match(
+    pika::graph::ClauseTable&) const
+{}
+
+template<typename Operand, typename... Levels>
+std::shared_ptr<pika::memotable::Match>
+pika::clause::Precedence<Operand, Levels...>::climb(
+    memotable::MemoTable& table, size_t start, size_t level) const
+{
+    const Clause* levels[] = {Levels().get_instance()...};
+    const Clause* operators[] = {
+        typename Levels::Operator().get_instance()...};
+    constexpr bool right[] = {Levels::RIGHT...};
+
+    auto lhs = Operand().packrat_match(table, start);
+    if (!lhs)
+    {
+        return nullptr;
+    }
+    auto end = start + lhs->get_length();
+    for (;;)
+    {
+        auto current = level;
+        std::shared_ptr<memotable::Match> op;
+        while (current < sizeof...(Levels) &&
+               !(op = operators[current]->packrat_match(table, end)))
+        {
+            current += 1;
+        }
+        if (!op)
+        {
+            break;
+        }
+        /*
+         * A right associative operator takes the rest of its level as its
+         * right operand, a left associative one only tighter operators.
+         */
+        auto rhs = climb(
+            table,
+            end + op->get_length(),
+            right[current] ? current : current + 1);
+        if (!rhs)
+        {
+            break;
+        }
+        end += op->get_length() + rhs->get_length();
+        std::shared_ptr<memotable::Match> operands[] = {
+            std::move(lhs), std::move(op), std::move(rhs)};
+        lhs = table.make_match(
+            memotable::MemoKey(levels[current], start),
+            end - start,
+            0,
+            absl::MakeSpan(operands));
+    }
+    return lhs;
+}
+
+template<typename Operand, typename... Levels>
+std::shared_ptr<pika::memotable::Match>
+pika::clause::Precedence<Operand, Levels...>::packrat_match(
+    memotable::MemoTable& table, size_t index) const
+{
+    PIKA_CHECKED_MATCH({
+        if (auto res = climb(table, index, 0))
+        {
+            return table.make_match(
+                pika::memotable::MemoKey(this->get_instance(), index),
+                res->get_length(),
+                0,
+                absl::MakeSpan(&res, 1));
+        }
+    });
+}
+
+template<typename Operand, typename... Levels>
+void pika::clause::Precedence<Operand, Levels...>::dfs_traversal(
+    absl::flat_hash_set<std::type_index>& visited,
+    std::vector<const Clause*>& terminals,
+    std::vector<const Clause*>& nodes) const
+{
+    PIKA_DFS_CHECK({
+        Operand().dfs_traversal(visited, terminals, nodes);
+        (Levels().dfs_traversal(visited, terminals, nodes), ...);
+        for (auto i : tails())
+        {
+            i->dfs_traversal(visited, terminals, nodes);
+        }
+        nodes.push_back(this->get_instance());
+    })
+}
+
+template<typename Operand, typename... Levels>
+void pika::clause::Precedence<Operand, Levels...>::mark_seeds(
+    pika::graph::ClauseTable& table) const
+{
+    table.at(typeid(Operand)).candidates.push_back(this->get_instance());
+}
+
+template<typename Operand, typename... Levels>
+void pika::clause::Precedence<Operand, Levels...>::sub_clauses(
+    std::vector<const Clause*>& output) const
+{
+    output.push_back(Operand().get_instance());
+    (output.push_back(Levels().get_instance()), ...);
+    for (auto i : tails())
+    {
+        output.push_back(i);
+    }
+}
+
+template<typename Operand, typename... Levels>
+pika::analysis::FirstSet
+pika::clause::Precedence<Operand, Levels...>::first_set(
+    const analysis::Analysis& analysis) const
+{
+    auto result = analysis[Operand()];
+    if (result.nullable)
+    {
+        return analysis::FirstSet::anything();
+    }
+    result.exact = false;
+    return result;
+}
+
+template<typename Operand, typename... Levels>
+void pika::clause::Precedence<Operand, Levels...>::pika_match(
+    pika::graph::ClauseTable& table) const
+{
+    auto operand = table.lookup(Operand().get_instance(), 0);
+    if (operand == table.memo_table.end())
+    {
+        return;
+    }
+    auto length = operand->second->length;
+    std::shared_ptr<memotable::Match> chain[] = {operand->second, nullptr};
+    auto tail = table.lookup(tails()[0], length);
+    if (tail != table.memo_table.end())
+    {
+        length += tail->second->length;
+        chain[1] = tail->second;
+    }
+    table.try_add(
+        this->get_instance(),
+        length,
+        memotable::Match::UNEXPANDED,
+        absl::MakeConstSpan(chain, chain[1] ? 2 : 1));
+}
+
+template<typename Operand, typename... Levels>
+std::shared_ptr<pika::memotable::Match>
+pika::clause::Precedence<Operand, Levels...>::expand(
+    const memotable::Match& match,
+    size_t position,
+    memotable::MemoTable& scratch) const
+{
+    const auto& chain = match.sub_matches;
+    auto folded = fold(
+        chain[0],
+        chain.size() > 1 ? chain[1].get() : nullptr,
+        position,
+        scratch);
+    return scratch.make_match(
+        memotable::MemoKey(match.key.tag, position),
+        match.length,
+        0,
+        absl::MakeSpan(&folded, 1));
+}
+
+template<typename Operand, typename... Levels>
+std::shared_ptr<pika::memotable::Match>
+pika::clause::Precedence<Operand, Levels...>::fold(
+    const std::shared_ptr<memotable::Match>& operand,
+    const memotable::Match* tail,
+    size_t start,
+    memotable::MemoTable& table) const
+{
+    const Clause* levels[] = {Levels().get_instance()...};
+    auto lhs = operand;
+    auto end = start + operand->length;
+    while (tail)
+    {
+        const auto& subs = tail->sub_matches;
+        auto rhs_start = end + subs[0]->length;
+        auto rhs = fold(
+            subs[1],
+            subs.size() > 2 ? subs[2].get() : nullptr,
+            rhs_start,
+            table);
+        end = rhs_start + rhs->length;
+        std::shared_ptr<memotable::Match> operands[] = {
+            std::move(lhs), subs[0], std::move(rhs)};
+        lhs = table.make_match(
+            memotable::MemoKey(levels[tail->sub_fst_idx], start),
+            end - start,
+            0,
+            absl::MakeSpan(operands));
+        tail = subs.size() > 3 ? subs[3].get() : nullptr;
+    }
+    return lhs;
+}
+
+template<typename Operand, typename... Levels>
+std::array<const pika::clause::Clause*, sizeof...(Levels)>
+pika::clause::Precedence<Operand, Levels...>::tails()
+{
+    return tails(std::make_index_sequence<sizeof...(Levels)>());
+}
+
+template<typename Operand, typename... Levels>
+template<size_t... L>
+std::array<const pika::clause::Clause*, sizeof...(Levels)>
+pika::clause::Precedence<Operand, Levels...>::tails(std::index_sequence<L...>)
+{
+    return {Tail<L>().get_instance()...};
+}
+
+template<typename Operand, typename... Levels>
+template<size_t L>
+void pika::clause::Precedence<Operand, Levels...>::Tail<L>::dfs_traversal(
+    absl::flat_hash_set<std::type_index>& visited,
+    std::vector<const Clause*>&,
+    std::vector<const Clause*>& nodes) const
+{
+    PIKA_DFS_CHECK({ nodes.push_back(this->get_instance()); })
+}
+
+template<typename Operand, typename... Levels>
+template<size_t L>
+void pika::clause::Precedence<Operand, Levels...>::Tail<L>::mark_seeds(
+    pika::graph::ClauseTable& table) const
+{
+    const Clause* operators[] = {
+        typename Levels::Operator().get_instance()...};
+    for (auto i = L; i < sizeof...(Levels); ++i)
+    {
+        table.at(typeid(*operators[i]))
+            .candidates.push_back(this->get_instance());
+    }
+}
+
+template<typename Operand, typename... Levels>
+template<size_t L>
+void pika::clause::Precedence<Operand, Levels...>::Tail<L>::sub_clauses(
+    std::vector<const Clause*>& output) const
+{
+    const Clause* operators[] = {
+        typename Levels::Operator().get_instance()...};
+    output.push_back(Operand().get_instance());
+    output.insert(output.end(), operators + L, std::end(operators));
+}
+
+template<typename Operand, typename... Levels>
+template<size_t L>
+pika::analysis::FirstSet
+pika::clause::Precedence<Operand, Levels...>::Tail<L>::first_set(
+    const analysis::Analysis& analysis) const
+{
+    analysis::FirstSet operators[] = {
+        analysis[typename Levels::Operator()]...};
+    analysis::FirstSet result;
+    for (auto i = L; i < sizeof...(Levels); ++i)
+    {
+        result = result.otherwise(operators[i]);
+    }
+    return result;
+}
+
+template<typename Operand, typename... Levels>
+template<size_t L>
+void pika::clause::Precedence<Operand, Levels...>::Tail<L>::pika_match(
+    pika::graph::ClauseTable& table) const
+{
+    const Clause* operators[] = {
+        typename Levels::Operator().get_instance()...};
+    constexpr bool right[] = {Levels::RIGHT...};
+    auto tails = Precedence::tails();
+    auto end = table.memo_table.cend();
+
+    auto current = L;
+    auto op = end;
+    while (current < sizeof...(Levels) &&
+           (op = table.lookup(operators[current], 0)) == end)
+    {
+        current += 1;
+    }
+    if (op == end)
+    {
+        return;
+    }
+    auto offset = op->second->length;
+    auto operand = table.lookup(Operand().get_instance(), offset);
+    if (operand == end)
+    {
+        return;
+    }
+    /*
+     * The right operand continues with the operators of its own level if
+     * right associative, only tighter ones otherwise. The entries of both
+     * chains start right of this column and are final.
+     */
+    std::shared_ptr<memotable::Match> subs[] = {
+        op->second, operand->second, nullptr, nullptr};
+    auto length = offset + operand->second->length;
+    auto level = right[current] ? current : current + 1;
+    if (level < sizeof...(Levels))
+    {
+        auto found = table.lookup(tails[level], length);
+        if (found != end)
+        {
+            subs[2] = found->second;
+            length += found->second->length;
+        }
+    }
+    auto next = table.lookup(tails[L], length);
+    if (next != end)
+    {
+        subs[3] = next->second;
+        length += next->second->length;
+    }
+    table.try_add(
+        this->get_instance(),
+        length,
+        current,
+        absl::MakeConstSpan(subs, subs[3] ? 4 : subs[2] ? 3 : 2));
+}
+
 template<typename H, typename... T>
 std::shared_ptr<pika::memotable::Match>
 pika::clause::Seq<H, T...>::packrat_match(
     memotable::MemoTable& table, size_t index) const
 {
-    PIKA_CHECKED_MATCH({ return packrat_reduce(table, index, 0, {}); });
+    PIKA_CHECKED_MATCH({
+        return packrat_reduce(
+            table, index, 0, table.packrat_operand_count());
+    });
 }
 
 #endif // PIKA_CLAUSE_IPP
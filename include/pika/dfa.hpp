@@ -0,0 +1,115 @@
+#ifndef PIKA_DFA_HPP
+#define PIKA_DFA_HPP
+
+#include <array>
+#include <optional>
+#include <pika/analysis.hpp>
+#include <pika/clause.hpp>
+#include <string_view>
+#include <vector>
+
+namespace pika
+{
+    namespace dfa
+    {
+        /*
+         * A table-driven automaton standing in for a regular clause: one
+         * built from byte terminals, literals, sequences, choices and
+         * repetitions, without recursion or lookahead. Only clauses whose
+         * choices and repetitions are all decided by the next byte are
+         * compiled, since PEG matching then agrees with the longest prefix
+         * the automaton accepts.
+         */
+        class Dfa;
+
+        /*
+         * Where the scans of one Dfa over one input went. A scan reaching a
+         * position in a state an earlier scan was in there takes over the
+         * rest of that scan, so each pair of position and state is only
+         * stepped through once however many columns the automaton is run
+         * from.
+         */
+        class Scans
+        {
+            /*
+             * `longest` is the furthest accepting position from here on,
+             * `stop` one past the last position the scan depended on.
+             * `next` links the visits of a position, 1-based like `heads`.
+             */
+            struct Visit
+            {
+                uint32_t state;
+                uint32_t next;
+                size_t longest;
+                size_t stop;
+            };
+
+            std::vector<uint32_t> heads;
+            std::vector<Visit> visits;
+            std::vector<uint32_t> path;
+
+            [[nodiscard]] const Visit*
+            find(size_t position, uint32_t state) const noexcept;
+
+            void add(
+                size_t position, uint32_t state, size_t longest, size_t stop);
+
+            friend Dfa;
+
+          public:
+            [[nodiscard]] size_t size() const noexcept;
+
+            [[nodiscard]] size_t bytes() const noexcept;
+
+            void clear() noexcept;
+        };
+
+        class Dfa
+        {
+            /*
+             * State 0 is the dead state and state 1 the start.
+             */
+            std::vector<std::array<uint32_t, 256>> transitions;
+            std::vector<bool> accepting;
+
+          public:
+            constexpr static size_t NO_MATCH = static_cast<size_t>(-1);
+
+            /*
+             * Clauses whose automaton would grow past this many states are
+             * left to the engines.
+             */
+            constexpr static size_t MAX_STATES = 1024;
+
+            /*
+             * The automaton of `clause`, or nothing if it is not regular in
+             * the above sense. `analysis` supplies the bytes of terminals.
+             */
+            static std::optional<Dfa> compile(
+                const clause::Clause& clause,
+                const analysis::Analysis& analysis);
+
+            /*
+             * The length of the longest prefix of `input` from `index` that
+             * the clause matches, or NO_MATCH. `depends` receives how many
+             * positions the result depended on, the end of input included.
+             */
+            size_t
+            match(std::string_view input, size_t index, size_t& depends) const;
+
+            /*
+             * The same, reusing and extending the earlier scans of `input`
+             * recorded in `scans`.
+             */
+            size_t match(
+                std::string_view input,
+                size_t index,
+                size_t& depends,
+                Scans& scans) const;
+
+            [[nodiscard]] size_t states() const noexcept;
+        };
+    }
+}
+
+#endif // PIKA_DFA_HPP
@@ -5,7 +5,10 @@
 #ifndef PIKA_GRAPH_HPP
 #define PIKA_GRAPH_HPP
 
+#include <absl/types/span.h>
+#include <pika/analysis.hpp>
 #include <pika/clause.hpp>
+#include <pika/dfa.hpp>
 #include <pika/memotable.hpp>
 #include <pika/type_utils.hpp>
 
@@ -18,6 +21,11 @@ namespace pika
             const pika::clause::Clause* instance;
             std::vector<const pika::clause::Clause*> candidates;
             const size_t topological_order;
+            /*
+             * Symbols at which the clause can match at all; it is not
+             * queued at any other column.
+             */
+            analysis::SymbolSet first;
 
             TableEntry(
                 const pika::clause::Clause* instance, size_t topological_order);
@@ -25,19 +33,139 @@ namespace pika
 
         using ParsingItem = std::pair<size_t, const pika::clause::Clause*>;
 
+        /*
+         * The pending clauses of a column; exposes the capacity of the
+         * underlying buffer so that it can be charged to the memory budget.
+         */
+        struct ColumnQueue
+        : public std::priority_queue<
+              ParsingItem,
+              std::vector<ParsingItem>,
+              std::greater<>>
+        {
+            [[nodiscard]] size_t capacity() const noexcept;
+        };
+
+        /*
+         * How far the columns of a ClauseTable looked ahead. The extent of a
+         * column is how far past it lies the rightmost input position it
+         * depended on, either directly or through the memo entries it looked
+         * up; it decides which columns an edit affects. Columns are held by
+         * the start position of their memo keys, see
+         * memotable::MemoTable::key_position, so an edit leaves the others
+         * in place. A tree of the largest key plus extent below each node
+         * finds those that looked across a position.
+         */
+        class Reach
+        {
+            /*
+             * ends[capacity + k] is k plus the extent of the column keyed
+             * k, or 0 before it is matched; ends[i] the larger of
+             * ends[2 * i] and ends[2 * i + 1].
+             */
+            std::vector<size_t> ends;
+
+          public:
+            explicit Reach(size_t keys);
+
+            [[nodiscard]] size_t extent(size_t key) const noexcept;
+
+            void set(size_t key, size_t extent);
+
+            /*
+             * Make room for the keys below `keys`.
+             */
+            void grow(size_t keys);
+
+            /*
+             * The keys from `first` up to `last` whose key plus extent is
+             * past `threshold`, from the largest to the smallest.
+             */
+            void crossing(
+                size_t first,
+                size_t last,
+                size_t threshold,
+                std::vector<size_t>& output) const;
+
+            [[nodiscard]] size_t bytes() const noexcept;
+        };
+
+        /*
+         * A single buffer modification: bytes in [start, end) of the old
+         * target were replaced by `replacement`.
+         */
+        struct Edit
+        {
+            size_t start;
+            size_t end;
+            std::string_view replacement;
+        };
+
+        /*
+         * How far a ClauseTable has matched: columns are processed from the
+         * end of the target towards its start, one per input position plus
+         * one for the end of input.
+         */
+        struct Progress
+        {
+            size_t matched_columns;
+            size_t total_columns;
+
+            [[nodiscard]] bool finished() const noexcept;
+        };
+
         struct ClauseTable
         : public absl::flat_hash_map<std::type_index, TableEntry>
         {
             const std::vector<const pika::clause::Clause*> specials;
             const std::vector<const pika::clause::Clause*> terminals;
             pika::memotable::MemoTable memo_table;
-            std::priority_queue<
-                ParsingItem,
-                std::vector<ParsingItem>,
-                std::greater<>>
-                column{};
+            ColumnQueue column{};
             size_t current_pos;
             const clause::Clause* toplevel;
+            Reach reach;
+            /*
+             * The end of the column being matched, see Reach, stored once it
+             * is done.
+             */
+            size_t column_end = 0;
+            size_t queue_bytes = 0;
+            /*
+             * The terminals and specials queued at the start of a column,
+             * by the symbol found there.
+             */
+            std::vector<std::vector<const pika::clause::Clause*>> seeds;
+            /*
+             * canonical[clause_id] is the clause whose memo entries stand in
+             * for the clause, itself unless construct_table merged it.
+             */
+            std::vector<const pika::clause::Clause*> canonical;
+            /*
+             * compiled[clause_id] is the DFA matching a regular subgrammar in
+             * place of the clause's pika_match, if construct_table built one.
+             */
+            std::vector<std::shared_ptr<const dfa::Dfa>> compiled;
+            /*
+             * scans[clause_id] holds the scans of compiled[clause_id] over
+             * the target, which a DFA run from a column to its left ends up
+             * sharing. Dropped by reparse, after which the automata run on
+             * their own.
+             */
+            std::vector<dfa::Scans> scans;
+            /*
+             * When set before matching, memo entries keep the length and
+             * alternative of a match but not its sub-matches, so an entry
+             * that was improved on is freed at once instead of staying
+             * referenced from those built on it. result() rebuilds the tree
+             * of the toplevel match with replay. Such tables cannot be
+             * reparsed.
+             */
+            bool length_only = false;
+            /*
+             * Set while replay matches a column again; try_add then keeps
+             * sub-matches even if length_only.
+             */
+            bool replaying = false;
 
             explicit ClauseTable(
                 std::vector<const pika::clause::Clause*> specials,
@@ -45,24 +173,124 @@ namespace pika
                 std::string_view target,
                 const clause::Clause* toplevel);
 
+            /*
+             * The byte of the current column. Past the end it is EOF, which
+             * is also a valid byte, so check eof() first.
+             */
             char get_current() const;
 
+            /*
+             * The current byte as an analysis symbol, END_OF_INPUT past the
+             * end.
+             */
+            size_t current_symbol() const;
+
+            [[nodiscard]] const clause::Clause*
+            resolve(const clause::Clause* clause) const;
+
+            memotable::MemoTable::const_iterator
+            lookup(const clause::Clause* clause, size_t offset);
+
+            /*
+             * Record that the current column looked at the next `length`
+             * bytes, or up to the end of input.
+             */
+            void extend_reach(size_t length);
+
+            /*
+             * Whether try_add would keep a match of the clause at the current
+             * column with `length` and `fst_idx`, for callers that build the
+             * sub-matches of a candidate first.
+             */
+            [[nodiscard]] bool improves(
+                const clause::Clause* clause,
+                size_t length,
+                size_t fst_idx) const;
+
+            /*
+             * Store a match of the clause at the current column if it is
+             * better than the one known. Nothing is allocated for a
+             * rejected candidate; `subs` are only copied into a kept one.
+             */
             void try_add(
                 const clause::Clause*,
                 size_t length,
                 size_t fst_idx,
-                std::vector<std::shared_ptr<memotable::Match>> subs);
+                absl::Span<const std::shared_ptr<memotable::Match>> subs);
 
             void add_candidates(std::type_index idx);
 
+            /*
+             * Match `clause` at the current column, by its DFA if compiled.
+             */
+            void evaluate(const clause::Clause* clause);
+
             bool eof() const;
 
             bool match_column();
             std::shared_ptr<memotable::Match> match();
+
+            /*
+             * Match at most `max_columns` columns, or columns until
+             * `max_time` has elapsed (at least one), and report how far the
+             * parse got. Once finished, result() holds the toplevel match.
+             */
+            Progress step(size_t max_columns);
+            Progress step(limits::Clock::duration max_time);
+
+            [[nodiscard]] Progress progress() const noexcept;
+
+            /*
+             * Bytes held by the parse, including the memo table, the column
+             * queue, the reach buffer and the DFA scans. Limited by the
+             * memory limit of memo_table.limits.
+             */
+            [[nodiscard]] size_t memory_usage() const noexcept;
+            [[nodiscard]] size_t measure_memory() const;
+            [[nodiscard]] std::shared_ptr<memotable::Match> result();
+
+            /*
+             * The entry of `clause` at `position` with its sub-matches, from
+             * a finished length_only table. The column is matched again from
+             * scratch: the columns to its right are final, so it ends up
+             * with the same entries, which are then put back. Returns
+             * nullptr if the clause has no entry there.
+             */
+            std::shared_ptr<memotable::Match>
+            replay(const clause::Clause* clause, size_t position);
+
+            /*
+             * A copy of `match` whose sub-matches, and theirs, were recovered
+             * by replay where length_only dropped them.
+             */
+            std::shared_ptr<memotable::Match>
+            rebuild(const std::shared_ptr<memotable::Match>& match);
+
+            /*
+             * Apply `edit` to a table that has finished matching. `updated`
+             * is the whole buffer after the edit and must outlive the table.
+             * Only the replaced columns and those that looked into them are
+             * matched again, the entries of the others stay in place. Every
+             * separate place edited adds a key run, see
+             * memotable::MemoTable::key_position, which lookups search.
+             * Throws std::logic_error if the table has not finished
+             * matching or is length_only, std::invalid_argument if `edit`
+             * does not fit the target or `updated` and std::length_error
+             * once the edits have inserted about 4 GiB in total, see
+             * memotable::MemoKey.
+             */
+            std::shared_ptr<memotable::Match>
+            reparse(const Edit& edit, std::string_view updated);
         };
 
+        /*
+         * Regular subgrammars of `toplevel` are matched by compiled DFAs
+         * unless `compile` is false, see dfa::Dfa.
+         */
         ClauseTable construct_table(
-            const clause::Clause& toplevel, std::string_view target);
+            const clause::Clause& toplevel,
+            std::string_view target,
+            bool compile = true);
     }
 }
 #endif // PIKA_GRAPH_HPP
@@ -0,0 +1,101 @@
+#ifndef PIKA_LIMITS_HPP
+#define PIKA_LIMITS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <stdexcept>
+
+namespace pika
+{
+    namespace limits
+    {
+        using Clock = std::chrono::steady_clock;
+
+        enum class Reason
+        {
+            Cancelled,
+            DeadlineExceeded,
+            MemoryExceeded
+        };
+
+        /*
+         * Thrown out of ClauseTable::match and packrat_match when a parse is
+         * abandoned. The table that was matching is left in an unspecified
+         * state and should be discarded.
+         */
+        class Aborted : public std::runtime_error
+        {
+            Reason _reason;
+
+          public:
+            explicit Aborted(Reason reason);
+
+            [[nodiscard]] Reason reason() const noexcept;
+        };
+
+        /*
+         * Shared between the parsing thread and whoever wants to stop it.
+         */
+        class CancellationToken
+        {
+            std::atomic<bool> cancelled{false};
+
+          public:
+            void cancel() noexcept;
+
+            [[nodiscard]] bool is_cancelled() const noexcept;
+        };
+
+        /*
+         * Budget of a single parse. Both engines tick once per clause
+         * evaluation; the clock and the token are only consulted every
+         * `interval` ticks, and never when no limit is set.
+         */
+        class Limits
+        {
+            std::optional<Clock::time_point> deadline;
+            const CancellationToken* token = nullptr;
+            size_t interval = 1024;
+            size_t countdown = SIZE_MAX;
+            size_t memory_limit = SIZE_MAX;
+
+            void rearm() noexcept;
+
+          public:
+            void set_deadline(Clock::time_point time_point) noexcept;
+
+            void set_timeout(Clock::duration duration) noexcept;
+
+            void set_token(const CancellationToken& cancellation) noexcept;
+
+            void set_interval(size_t ticks) noexcept;
+
+            /*
+             * Upper bound on the bytes accounted by the MemoTable, see
+             * MemoTable::memory_usage.
+             */
+            void set_memory_limit(size_t bytes) noexcept;
+
+            void check();
+
+            void tick()
+            {
+                if (--countdown == 0)
+                {
+                    check();
+                }
+            }
+
+            void check_memory(size_t usage) const
+            {
+                if (usage > memory_limit)
+                {
+                    throw Aborted(Reason::MemoryExceeded);
+                }
+            }
+        };
+    }
+}
+
+#endif // PIKA_LIMITS_HPP
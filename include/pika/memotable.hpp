@@ -2,8 +2,15 @@
 #define PIKA_MEMOTABLE_HPP
 
 #include <absl/container/flat_hash_map.h>
+#include <absl/types/span.h>
+#include <pika/analysis.hpp>
 #include <pika/clause.hpp>
+#include <pika/limits.hpp>
+#include <pika/statistics.hpp>
+#include <pika/trace.hpp>
 #include <pika/type_utils.hpp>
+#include <limits>
+#include <memory>
 #include <typeindex>
 #include <utility>
 
@@ -16,10 +23,15 @@ namespace pika
     }
     namespace memotable
     {
+        /*
+         * Memo keys and entries hold positions, lengths and alternatives in
+         * 32 bits, which limits targets to 4 GiB. A key names its clause by
+         * clause_id.
+         */
         struct MemoKey
         {
-            const std::type_index clause_type;
-            const size_t start_position;
+            uint32_t clause;
+            uint32_t start_position;
             const clause::Clause* const tag;
 
             MemoKey(const clause::Clause* tag, size_t start_position) noexcept;
@@ -27,8 +39,7 @@ namespace pika
             template<typename H>
             friend H AbslHashValue(H h, const MemoKey& k)
             {
-                return H::combine(
-                    std::move(h), k.clause_type, k.start_position);
+                return H::combine(std::move(h), k.clause, k.start_position);
             }
 
             bool operator==(const MemoKey& that) const noexcept;
@@ -37,14 +48,84 @@ namespace pika
             get_base_type() const noexcept;
         };
 
+        /*
+         * The bytes charged to a MemoTable. Matches can outlive their table,
+         * so they share the ledger and give their bytes back when freed.
+         */
+        struct Ledger
+        {
+            size_t usage = 0;
+        };
+
+        /*
+         * Allocator for std::allocate_shared that charges `bytes` to the
+         * ledger along with the allocation of a match and its control
+         * block, and releases them once the last reference to it is gone.
+         */
+        template<typename T>
+        struct LedgerAllocator
+        {
+            using value_type = T;
+
+            std::shared_ptr<Ledger> ledger;
+            size_t bytes;
+
+            LedgerAllocator(std::shared_ptr<Ledger> ledger, size_t bytes)
+            : ledger(std::move(ledger)), bytes(bytes)
+            {}
+
+            template<typename U>
+            LedgerAllocator(const LedgerAllocator<U>& that)
+            : ledger(that.ledger), bytes(that.bytes)
+            {}
+
+            T* allocate(size_t count)
+            {
+                auto result = std::allocator<T>().allocate(count);
+                ledger->usage += bytes;
+                return result;
+            }
+
+            void deallocate(T* pointer, size_t count) noexcept
+            {
+                ledger->usage -= bytes;
+                std::allocator<T>().deallocate(pointer, count);
+            }
+
+            template<typename U>
+            bool operator==(const LedgerAllocator<U>& that) const noexcept
+            {
+                return ledger == that.ledger;
+            }
+
+            template<typename U>
+            bool operator!=(const LedgerAllocator<U>& that) const noexcept
+            {
+                return ledger != that.ledger;
+            }
+        };
+
+        /*
+         * The key of a match gives the clause and where it was stored, see
+         * MemoTable::position; a sub-match starts where the sub-matches
+         * before it end, which is how TreeNode places them.
+         */
         class Match
         {
           public:
-            const MemoKey key;
-            const size_t length;
-            const size_t sub_fst_idx;
+            MemoKey key;
+            const uint32_t length;
+            const uint32_t sub_fst_idx;
             const std::vector<std::shared_ptr<Match>> sub_matches;
 
+            /*
+             * The sub_fst_idx of a match stored without its final
+             * sub-matches: one found by a compiled DFA, which only knows its
+             * length, or a Precedence operator chain. TreeNode recovers them
+             * with clause::Clause::expand.
+             */
+            constexpr static uint32_t UNEXPANDED = UINT32_MAX;
+
             friend pika::parse_tree::TreeNode;
 
             Match(
@@ -55,23 +136,358 @@ namespace pika
 
             bool is_better_than(const Match& that);
 
+            /*
+             * Whether a match of the same clause with `length` and
+             * `sub_fst_idx` would be better than this one, decided before
+             * the candidate is built.
+             */
+            [[nodiscard]] bool
+            is_improved_by(size_t length, size_t sub_fst_idx) const noexcept;
+
             [[nodiscard]] size_t get_length() const;
+
+            /*
+             * Bytes owned by this match: the object itself, the control block
+             * shared with it by MemoTable::make_match and the sub-match
+             * storage.
+             */
+            [[nodiscard]] size_t footprint() const noexcept;
+
+            /*
+             * The footprint of a match with room for `capacity` sub-matches.
+             */
+            [[nodiscard]] static size_t footprint(size_t capacity) noexcept;
+        };
+
+        /*
+         * Packrat memo of a single clause. Failed positions only cost one bit;
+         * a successful position holds a 1-based slot into the shared match
+         * pool, with 0 meaning the position is not matched (yet). Positions
+         * are stored relative to the table's packrat base, everything before
+         * it has been evicted. Transient rows are never filled and their
+         * clauses are always evaluated. `clause` is known once the row holds
+         * a match or the grammar was analysed up front, and `first` then
+         * narrows down the symbols the clause can match at.
+         */
+        struct PackratRow
+        {
+            std::vector<uint64_t> failed;
+            std::vector<uint64_t> cuts;
+            std::vector<uint32_t> slots;
+            bool transient = false;
+            const clause::Clause* clause = nullptr;
+            analysis::SymbolSet first = ~analysis::SymbolSet{};
+        };
+
+        /*
+         * A pending backtracking point of the packrat engine: the position a
+         * choice clause falls back to if its current attempt fails.
+         */
+        struct PackratChoice
+        {
+            size_t restart;
+            size_t commits;
+            bool committed;
+        };
+
+        /*
+         * Work done by a parse, counted in operations rather than time so that
+         * it is reproducible: columns processed, clauses evaluated, clauses
+         * queued, memo entries written and memo lookups that found an entry.
+         */
+        struct OperationCounters
+        {
+            size_t columns = 0;
+            size_t evaluations = 0;
+            size_t pushes = 0;
+            size_t insertions = 0;
+            size_t hits = 0;
+        };
+
+        /*
+         * What a single clause holds in a memo table: its successful entries,
+         * the positions recorded as failed (packrat only), the bytes charged
+         * to it, the sub-matches of its entries and how many input positions
+         * its matches span.
+         */
+        struct ClauseOccupancy
+        {
+            const clause::Clause* clause = nullptr;
+            size_t entries = 0;
+            size_t failures = 0;
+            size_t bytes = 0;
+            size_t sub_matches = 0;
+            size_t covered = 0;
+
+            [[nodiscard]] double average_sub_matches() const noexcept;
+        };
+
+        struct Occupancy
+        {
+            /*
+             * Clauses holding at least one entry, largest first.
+             */
+            std::vector<ClauseOccupancy> clauses;
+            size_t entries = 0;
+            size_t failures = 0;
+            size_t bytes = 0;
+
+            /*
+             * Entries starting at each input position, only filled on
+             * request.
+             */
+            std::vector<size_t> histogram;
+
+            /*
+             * A line per clause in the format of Clause::dump, then the
+             * histogram folded into at most `rows` rows.
+             */
+            void dump(std::ostream& output, size_t rows = 32) const;
         };
 
         class MemoTable
         : public absl::flat_hash_map<MemoKey, std::shared_ptr<Match>>
         {
             std::string_view target;
+            std::vector<PackratRow> packrat_rows;
+            std::vector<std::shared_ptr<Match>> packrat_matches;
+            std::vector<uint32_t> packrat_free;
+            std::vector<PackratChoice> packrat_choices;
+            /*
+             * The sub-matches of the sequences being evaluated, each
+             * sequence pushing on top of those enclosing it.
+             */
+            std::vector<std::shared_ptr<Match>> packrat_operands;
+            size_t packrat_base = 0;
+            size_t packrat_extent = 0;
+            bool packrat_cut_seen = false;
+            std::shared_ptr<Ledger> ledger = std::make_shared<Ledger>();
+            /*
+             * A run keys the input positions from `position` up to the next
+             * run by consecutive keys from `key`, see key_position. Empty
+             * while every position is its own key, that is until
+             * graph::ClauseTable::reparse replaces some of them.
+             */
+            struct KeyRun
+            {
+                size_t position;
+                size_t key;
+            };
+            std::vector<KeyRun> key_runs;
+            size_t next_key = 0;
+
+            void packrat_evict(size_t floor);
+
+            /*
+             * Give the `inserted` positions that replace the `removed` ones
+             * from `start` fresh keys. Positions after them keep their keys,
+             * so their entries stay in place; this takes time in the number
+             * of runs only.
+             */
+            void replace_keys(size_t start, size_t removed, size_t inserted);
 
           public:
             friend pika::graph::ClauseTable;
             friend pika::parse_tree::TreeNode;
 
+            /*
+             * Deadline and cancellation of the parse using this table, for
+             * either engine.
+             */
+            pika::limits::Limits limits;
+
+            OperationCounters counters;
+
+            /*
+             * Per-clause breakdown of the work, filled by both engines when
+             * built with PIKA_STATISTICS.
+             */
+            pika::statistics::Statistics statistics;
+
+            /*
+             * Receives timed events of both engines when set; not owned.
+             */
+            pika::trace::Tracer* tracer = nullptr;
+
+            /*
+             * Throws std::length_error if `target` does not fit the 32-bit
+             * positions of the memo.
+             */
             explicit MemoTable(std::string_view target);
 
+            /*
+             * Only memorize the clauses of `toplevel` that pay off: terminals,
+             * clauses referenced from a single place and clauses declared by
+             * PIKA_DECLARE_UNMEMOIZED are evaluated directly instead. The
+             * FIRST sets of the grammar let choices skip alternatives that
+             * cannot match at the current symbol.
+             */
+            MemoTable(std::string_view target, const clause::Clause& toplevel);
+
             [[nodiscard]] char get_char(size_t index) const;
 
+            /*
+             * The start_position of the key of an entry at `position`, and
+             * back. Both are the position itself unless the table was
+             * reparsed; then they search the key runs.
+             */
+            [[nodiscard]] size_t key_position(size_t position) const noexcept;
+            [[nodiscard]] size_t position(const MemoKey& key) const noexcept;
+
             [[nodiscard]] bool at_end(size_t index) const;
+
+            /*
+             * Whether the target continues with `literal` at index.
+             */
+            [[nodiscard]] bool
+            matches(size_t index, std::string_view literal) const;
+
+            /*
+             * The target from index to its end.
+             */
+            [[nodiscard]] std::string_view rest(size_t index) const;
+
+            /*
+             * False if the clause cannot match at index according to the
+             * analysis done by the constructor; true when unknown.
+             */
+            [[nodiscard]] bool
+            packrat_viable(size_t clause_id, size_t index) const;
+
+            /*
+             * Returns nullptr if the clause has not been tried at index yet,
+             * otherwise a pointer to the memorized result, which is itself
+             * null when the attempt failed.
+             */
+            [[nodiscard]] const std::shared_ptr<Match>*
+            packrat_find(size_t clause_id, size_t index) const;
+
+            /*
+             * `committed` records that the evaluation cut its enclosing choice,
+             * so that memo hits can replay the cut.
+             */
+            std::shared_ptr<Match> packrat_store(
+                size_t clause_id,
+                size_t index,
+                std::shared_ptr<Match> match,
+                bool committed = false);
+
+            template<typename F>
+            std::shared_ptr<Match>
+            packrat_memoize(size_t clause_id, size_t index, F&& evaluate)
+            {
+                if (auto memo = packrat_find(clause_id, index))
+                {
+                    if (packrat_cut_seen)
+                    {
+                        packrat_replay(clause_id, index);
+                    }
+                    counters.hits += 1;
+                    PIKA_STATISTIC(*this, clause_id, hits);
+                    return *memo;
+                }
+                limits.tick();
+                counters.evaluations += 1;
+                PIKA_STATISTIC(*this, clause_id, misses);
+                auto depth = packrat_choices.size();
+                auto commits = depth ? packrat_choices.back().commits : 0;
+                auto result = evaluate();
+                if (result)
+                {
+                    PIKA_STATISTIC(*this, clause_id, matches);
+                }
+                auto committed =
+                    depth && packrat_choices[depth - 1].commits != commits;
+                return packrat_store(
+                    clause_id, index, std::move(result), committed);
+            }
+
+            void packrat_replay(size_t clause_id, size_t index);
+
+            void packrat_enter(size_t restart);
+
+            void packrat_restart(size_t restart);
+
+            /*
+             * Pops the innermost choice and returns whether it was cut.
+             */
+            bool packrat_leave();
+
+            [[nodiscard]] bool packrat_committed() const;
+
+            /*
+             * Commits the innermost choice and evicts the memo entries that
+             * can no longer be reached by backtracking.
+             */
+            void packrat_cut(size_t index);
+
+            [[nodiscard]] size_t packrat_size() const noexcept;
+
+            [[nodiscard]] size_t packrat_operand_count() const noexcept;
+
+            void packrat_push_operand(std::shared_ptr<Match> match);
+
+            /*
+             * The operands pushed since there were `base` of them.
+             */
+            absl::Span<std::shared_ptr<Match>>
+            packrat_top_operands(size_t base);
+
+            void packrat_drop_operands(size_t base);
+
+            /*
+             * A match of either engine. Its footprint stays charged to this
+             * table until the match is freed, whether it is still in the
+             * memo, the sub-match of another match or held by the caller.
+             * Aborts the parse if the memory limit is exceeded.
+             */
+            std::shared_ptr<Match> make_match(
+                MemoKey key,
+                size_t length,
+                size_t sub_fst_idx,
+                std::vector<std::shared_ptr<Match>> sub_matches = {});
+
+            std::shared_ptr<Match> make_match(
+                MemoKey key,
+                size_t length,
+                size_t sub_fst_idx,
+                absl::Span<const std::shared_ptr<Match>> sub_matches);
+
+            /*
+             * Moves the sub-matches out of `sub_matches`.
+             */
+            std::shared_ptr<Match> make_match(
+                MemoKey key,
+                size_t length,
+                size_t sub_fst_idx,
+                absl::Span<std::shared_ptr<Match>> sub_matches);
+
+            /*
+             * Record `bytes` more (or less) memory held by the parse and abort
+             * it if the memory limit is exceeded.
+             */
+            void account(ptrdiff_t bytes);
+
+            /*
+             * Live count of the bytes held by memo entries, matches, sub-match
+             * storage and the engines' buffers, kept up to date on every
+             * change.
+             */
+            [[nodiscard]] size_t memory_usage() const noexcept;
+
+            /*
+             * The same quantity recomputed from scratch by walking the table
+             * and the matches reachable from it. Matches only held from
+             * outside, such as the result of an earlier parse, are not
+             * found.
+             */
+            [[nodiscard]] size_t measure_memory() const;
+
+            /*
+             * Breaks the entries of both engines down by clause. Walks the
+             * whole table, so it is meant for after the parse.
+             */
+            [[nodiscard]] Occupancy occupancy(bool histogram = false) const;
         };
     }
 }
@@ -6,6 +6,7 @@
 #define PIKA_PARSE_TREE_HPP
 
 #include <memory>
+#include <optional>
 #include <pika/clause.hpp>
 #include <pika/memotable.hpp>
 #include <vector>
@@ -19,10 +20,54 @@ namespace pika
             const std::vector<std::unique_ptr<const TreeNode>> branches;
             const pika::clause::Clause* const matched_clause;
 
+            /*
+             * Packrat memo in which the matches of a compiled DFA are
+             * matched again, shared by the whole tree and only created once
+             * one of them is found.
+             */
+            using Scratch = std::optional<pika::memotable::MemoTable>;
+
+            /*
+             * `position` is where the match starts; its sub-matches follow
+             * each other from there.
+             */
+            TreeNode(
+                const pika::memotable::Match& match,
+                size_t position,
+                const pika::memotable::MemoTable& table,
+                Scratch&& scratch);
+
+            TreeNode(
+                const std::shared_ptr<const pika::memotable::Match>& match,
+                size_t position,
+                const pika::memotable::MemoTable& table,
+                Scratch& scratch);
+
+            static std::vector<std::unique_ptr<const TreeNode>>
+            build_from_match(
+                const pika::memotable::Match& match,
+                size_t position,
+                const pika::memotable::MemoTable& table,
+                Scratch& scratch);
+
+            static std::vector<std::unique_ptr<const TreeNode>> reduced(
+                std::type_index parent,
+                pika::type_utils::BaseType base,
+                const std::vector<std::shared_ptr<pika::memotable::Match>>&
+                    sub_matches,
+                size_t position,
+                const pika::memotable::MemoTable& table,
+                Scratch& scratch);
+
           public:
             using const_iterator =
                 std::vector<std::unique_ptr<const TreeNode>>::const_iterator;
             const std::string_view matched_content;
+            /*
+             * Which alternative of a choice matched: the index of the
+             * Ord alternative or of the keyword of a Keywords clause.
+             */
+            const size_t alternative;
 
             template<class Clause>
             bool is_clause() const
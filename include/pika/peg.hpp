@@ -0,0 +1,263 @@
+#ifndef PIKA_PEG_HPP
+#define PIKA_PEG_HPP
+
+#include <absl/container/flat_hash_map.h>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace pika
+{
+    namespace peg
+    {
+        enum class Op : uint8_t
+        {
+            Seq,
+            Ord,
+            Asterisks,
+            Plus,
+            Optional,
+            FollowedBy,
+            NotFollowedBy,
+            Set,
+            String
+        };
+
+        /*
+         * A clause of a loaded grammar. Composite clauses match
+         * children[first, first + count) of their Grammar; a Set matches a
+         * byte of sets[first] and a String the bytes literals[first, first +
+         * count). `rule` is the rule whose body the clause is, if any.
+         */
+        struct Instruction
+        {
+            Op op;
+            uint32_t rule;
+            uint32_t first;
+            uint32_t count;
+        };
+
+        struct Rule
+        {
+            std::string name;
+            uint32_t body;
+            /*
+             * Whether matches of the rule show up in parse trees, false for
+             * rules declared with a leading `~`.
+             */
+            bool active;
+        };
+
+        /*
+         * A node of a parse tree: an active rule and the span it matched.
+         */
+        struct Node
+        {
+            uint32_t rule;
+            size_t start;
+            size_t length;
+            std::vector<Node> children;
+        };
+
+        /*
+         * A grammar loaded at runtime from PEG text, as a flat table of
+         * instructions referring to each other by index. Rules are written
+         * `Name <- expression`; expressions are built from 'literals',
+         * "literals", [classes] (`\n`, `\xHH` and friends escaped, a leading
+         * `^` negating), `.` for any byte, rule names and parentheses, with
+         * the prefixes `&` and `!`, the suffixes `?`, `*` and `+`,
+         * juxtaposition for sequence and `/` for ordered choice. `#` starts
+         * a comment.
+         */
+        class Grammar
+        {
+          public:
+            constexpr static uint32_t NO_RULE = UINT32_MAX;
+
+            std::vector<Instruction> instructions;
+            std::vector<uint32_t> children;
+            std::vector<std::array<uint64_t, 4>> sets;
+            std::string literals;
+            std::vector<Rule> rules;
+
+            /*
+             * For the pika interpreter: instructions in topological order,
+             * sub-clauses first, the instructions whose match may start one
+             * of parents[parents_start[i], parents_start[i + 1]), and the
+             * instructions tried first at a column by the byte found there,
+             * index 256 being the end of input. Terminals that can match the
+             * byte are seeded, as is everything that may match empty
+             * without a match of its sub-clause.
+             */
+            std::vector<uint32_t> order;
+            std::vector<uint32_t> parents_start;
+            std::vector<uint32_t> parents;
+            std::vector<std::vector<uint32_t>> seeds;
+
+            /*
+             * Parses `text`, itself with a grammar declared by PIKA_DECLARE.
+             * Nothing if the text does not parse, defines a rule twice or
+             * refers to an undefined one.
+             */
+            static std::optional<Grammar> load(std::string_view text);
+
+            [[nodiscard]] std::optional<uint32_t>
+            find(std::string_view name) const;
+
+            [[nodiscard]] bool contains(uint32_t set, char c) const noexcept;
+        };
+
+        constexpr size_t NO_MATCH = static_cast<size_t>(-1);
+
+        /*
+         * Top-down interpreter of a Grammar, memoizing the rules. A left
+         * recursive rule fails when it is reached again at the same
+         * position, instead of recursing forever.
+         */
+        class Packrat
+        {
+            const Grammar& grammar;
+            std::string_view input;
+            /*
+             * memo[index * rules + rule] is 1 on failure and the matched
+             * length plus 2 otherwise, missing where the rule was not tried.
+             */
+            absl::flat_hash_map<uint64_t, uint32_t> memo;
+
+            size_t evaluate(uint32_t instruction, size_t index);
+
+            /*
+             * Appends the nodes within a match of `instruction`, replaying
+             * its choices from the memo.
+             */
+            void collect(
+                uint32_t instruction,
+                size_t index,
+                size_t matched,
+                std::vector<Node>& output);
+
+          public:
+            /*
+             * Inputs are limited to 4 GiB by the memo, longer ones throw
+             * std::length_error.
+             */
+            Packrat(const Grammar& grammar, std::string_view input);
+
+            /*
+             * The length matched by `rule` at `index`, or NO_MATCH.
+             */
+            size_t match(uint32_t rule, size_t index);
+
+            /*
+             * The tree of `rule` matched at `index`.
+             */
+            std::optional<Node> parse(uint32_t rule, size_t index = 0);
+
+            [[nodiscard]] size_t entries() const noexcept;
+        };
+
+        /*
+         * Bottom-up interpreter of a Grammar, the pika_match semantics of
+         * graph::ClauseTable: columns are matched from the end of input to
+         * its start, each by a priority queue over the instructions in
+         * topological order, which also grows left recursive rules.
+         */
+        class PikaTable
+        {
+            /*
+             * Improving a match adds another: the one it replaces may still
+             * be a sub-match of others, like the shorter matches of a left
+             * recursive rule. submatches[first, first + count) are the
+             * sub-matches.
+             */
+            struct Match
+            {
+                uint32_t instruction;
+                uint32_t alternative;
+                size_t length;
+                uint32_t first;
+                uint32_t count;
+            };
+
+            constexpr static uint32_t NONE = UINT32_MAX;
+
+            const Grammar& grammar;
+            std::string_view input;
+            std::vector<Match> matches;
+            std::vector<uint32_t> submatches;
+            /*
+             * Matches replaced in the memo since the last compact().
+             */
+            size_t replaced = 0;
+            /*
+             * The best match by instruction and position, and the
+             * sub-matches of the one being evaluated.
+             */
+            absl::flat_hash_map<uint64_t, uint32_t> memo;
+            std::vector<uint32_t> pending;
+            std::priority_queue<
+                std::pair<uint32_t, uint32_t>,
+                std::vector<std::pair<uint32_t, uint32_t>>,
+                std::greater<>>
+                queue;
+            size_t position;
+
+            [[nodiscard]] uint32_t
+            find(uint32_t instruction, size_t index) const;
+
+            /*
+             * Records a match at the current position with the pending
+             * sub-matches if it is better than the one known.
+             */
+            void add(uint32_t instruction, size_t length, uint32_t alternative);
+
+            void evaluate(uint32_t instruction);
+
+            /*
+             * Drops the matches no longer reachable from the memo, run
+             * between columns once replacements make up half of them.
+             */
+            void compact();
+
+            /*
+             * Appends the nodes within `match`, which starts at `index`;
+             * `node` adds the node of the match itself if it is active.
+             */
+            void collect(
+                uint32_t match,
+                size_t index,
+                bool node,
+                std::vector<Node>& output) const;
+
+          public:
+            PikaTable(const Grammar& grammar, std::string_view input);
+
+            /*
+             * Match all columns.
+             */
+            void match();
+
+            /*
+             * The length matched by `rule` at `index`, or NO_MATCH.
+             */
+            [[nodiscard]] size_t lookup(uint32_t rule, size_t index) const;
+
+            [[nodiscard]] std::optional<Node>
+            parse(uint32_t rule, size_t index = 0) const;
+
+            [[nodiscard]] size_t entries() const noexcept;
+
+            /*
+             * Matches held, those in the memo and those replaced but still
+             * kept as sub-matches or not dropped yet.
+             */
+            [[nodiscard]] size_t held() const noexcept;
+        };
+    }
+}
+
+#endif // PIKA_PEG_HPP
@@ -0,0 +1,74 @@
+#ifndef PIKA_STATISTICS_HPP
+#define PIKA_STATISTICS_HPP
+
+#include <ostream>
+#include <pika/clause.hpp>
+#include <vector>
+
+/*
+ * Per-clause counters are only collected when the library and its users are
+ * built with PIKA_STATISTICS; otherwise PIKA_STATISTIC expands to nothing and
+ * the tables stay empty.
+ */
+#ifdef PIKA_STATISTICS
+#    define PIKA_STATISTIC(TABLE, CLAUSE, FIELD) \
+        ((TABLE).statistics[CLAUSE].FIELD += 1)
+#else
+#    define PIKA_STATISTIC(TABLE, CLAUSE, FIELD) static_cast<void>(0)
+#endif
+
+namespace pika
+{
+    namespace statistics
+    {
+        /*
+         * Work attributed to a single clause. `improvements` and `rejections`
+         * split the matches offered to the pika memo table by whether they
+         * replaced the stored entry; `duplicates` are queue pushes of a clause
+         * that was still pending in the same column.
+         */
+        struct ClauseStatistics
+        {
+            const clause::Clause* clause = nullptr;
+            size_t evaluations = 0;
+            size_t matches = 0;
+            size_t improvements = 0;
+            size_t rejections = 0;
+            size_t pushes = 0;
+            size_t duplicates = 0;
+            size_t hits = 0;
+            size_t misses = 0;
+        };
+
+        class Statistics
+        {
+            std::vector<ClauseStatistics> clauses;
+
+          public:
+            ClauseStatistics& operator[](size_t clause_id);
+
+            ClauseStatistics& operator[](const clause::Clause* clause);
+
+            /*
+             * Returns nullptr when nothing was recorded for the clause.
+             */
+            [[nodiscard]] const ClauseStatistics*
+            find(const clause::Clause* clause) const;
+
+            /*
+             * Every clause with recorded work, busiest first.
+             */
+            [[nodiscard]] std::vector<ClauseStatistics> collect() const;
+
+            void clear() noexcept;
+
+            /*
+             * One line per clause in the format of Clause::dump, followed by
+             * its counters.
+             */
+            void dump(std::ostream& output) const;
+        };
+    }
+}
+
+#endif // PIKA_STATISTICS_HPP
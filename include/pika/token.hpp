@@ -0,0 +1,94 @@
+#ifndef PIKA_TOKEN_HPP
+#define PIKA_TOKEN_HPP
+
+#include <optional>
+#include <pika/clause.hpp>
+#include <pika/dfa.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace pika
+{
+    namespace token
+    {
+        /*
+         * The input of a grammar written over tokens instead of bytes. Each
+         * token is a single symbol, its kind, in symbols(), which is parsed
+         * like any other input; grammars match kinds with PIKA_TOKEN. Every
+         * column of the pika engine is then a token rather than a byte.
+         * Positions in symbols() map back to the source through spans.
+         */
+        class TokenStream
+        {
+            std::string_view source;
+            std::string kinds;
+            std::vector<std::pair<size_t, size_t>> spans;
+
+          public:
+            explicit TokenStream(std::string_view source);
+
+            /*
+             * Append a token of `kind` covering `length` source bytes from
+             * `start`; tokens are pushed in source order.
+             */
+            void push(uint8_t kind, size_t start, size_t length);
+
+            [[nodiscard]] std::string_view symbols() const noexcept;
+
+            [[nodiscard]] size_t size() const noexcept;
+
+            /*
+             * The source bytes from the first of `count` tokens at
+             * `position` to the last, including anything skipped in
+             * between. Empty at the token's start when `count` is 0.
+             */
+            [[nodiscard]] std::string_view
+            source_span(size_t position, size_t count) const;
+
+            /*
+             * The same for a view into symbols(), like the matched_content
+             * of a TreeNode.
+             */
+            [[nodiscard]] std::string_view
+            source_span(std::string_view matched) const;
+        };
+
+        /*
+         * A maximal munch lexer over regular clauses, each compiled to a
+         * dfa::Dfa. The longest match wins, the earlier rule on a tie.
+         */
+        class Lexer
+        {
+            struct Rule
+            {
+                int kind;
+                dfa::Dfa automaton;
+            };
+
+            std::vector<Rule> rules;
+
+          public:
+            /*
+             * The kind of rules whose tokens are dropped, like whitespace.
+             */
+            constexpr static int SKIP = -1;
+
+            /*
+             * False if the clause is not regular, see dfa::Dfa, or if `kind`
+             * is neither SKIP nor a byte, 0 to 255.
+             */
+            bool add(int kind, const clause::Clause& clause);
+
+            /*
+             * Nothing if some input is not matched by any rule.
+             */
+            [[nodiscard]] std::optional<TokenStream>
+            tokenize(std::string_view source) const;
+        };
+    }
+}
+
+#define PIKA_TOKEN(KIND) pika::clause::Char<static_cast<char>(KIND)>
+
+#endif // PIKA_TOKEN_HPP
@@ -0,0 +1,111 @@
+#ifndef PIKA_TRACE_HPP
+#define PIKA_TRACE_HPP
+
+#include <ostream>
+#include <pika/clause.hpp>
+#include <pika/limits.hpp>
+#include <vector>
+
+namespace pika
+{
+    namespace trace
+    {
+        /*
+         * A timed span of the parse: either a pika column (clause is null)
+         * or one packrat evaluation of a clause starting at `position`.
+         */
+        struct Event
+        {
+            const clause::Clause* clause;
+            size_t position;
+            size_t queue_depth;
+            size_t evaluations;
+            limits::Clock::time_point start;
+            limits::Clock::duration duration;
+        };
+
+        /*
+         * Collects events into a preallocated buffer while the parse runs and
+         * formats them only when written. Attach one through
+         * MemoTable::tracer; events past `capacity` are dropped and counted.
+         */
+        class Tracer
+        {
+            std::vector<Event> events;
+            size_t capacity;
+            size_t dropped_events = 0;
+            limits::Clock::time_point origin;
+
+            void record(const Event& event);
+
+          public:
+            explicit Tracer(size_t capacity = 1 << 20);
+
+            /*
+             * A pika column that started at `start` and ends now.
+             */
+            void column(
+                size_t position,
+                limits::Clock::time_point start,
+                size_t queue_depth,
+                size_t evaluations);
+
+            void clause(
+                const clause::Clause* clause,
+                size_t position,
+                limits::Clock::time_point start);
+
+            [[nodiscard]] const std::vector<Event>& get_events() const noexcept;
+
+            [[nodiscard]] size_t dropped() const noexcept;
+
+            void clear() noexcept;
+
+            /*
+             * Chrome trace event JSON, loadable by Perfetto and
+             * chrome://tracing. Columns and clause evaluations are complete
+             * ("X") events; the queue depth of every column is also emitted
+             * as a counter track.
+             */
+            void write(std::ostream& output) const;
+        };
+
+        /*
+         * Times a packrat evaluation when a tracer is attached; costs a null
+         * check otherwise.
+         */
+        class Scope
+        {
+            Tracer* tracer;
+            const clause::Clause* clause = nullptr;
+            size_t position = 0;
+            limits::Clock::time_point start;
+
+          public:
+            Scope(Tracer* tracer, const clause::Clause* clause, size_t position)
+            : tracer(tracer)
+            {
+                if (tracer)
+                {
+                    this->clause = clause->get_instance();
+                    this->position = position;
+                    start = limits::Clock::now();
+                }
+            }
+
+            Scope(const Scope&) = delete;
+
+            Scope& operator=(const Scope&) = delete;
+
+            ~Scope()
+            {
+                if (tracer)
+                {
+                    tracer->clause(clause, position, start);
+                }
+            }
+        };
+    }
+}
+
+#endif // PIKA_TRACE_HPP
@@ -16,11 +16,18 @@ namespace pika
             FollowedBy,
             NotFollowedBy,
             Plus,
+            Repeat,
+            Infix,
+            Precedence,
             Char,
             CharRange,
+            String,
+            CharSet,
+            Keywords,
             First,
             Nothing,
             Any,
+            Cut,
             Error
         };
 #define PIKA_CHECK_BASE(NAMESPACE, TYPE) \
@@ -37,7 +44,7 @@ namespace pika
         {
             PIKA_CHECK_BASE(pika::clause::_internal, Seq)
             else PIKA_CHECK_BASE(pika::clause::_internal, Ord) else PIKA_CHECK_BASE(pika::clause::_internal, Asterisks) else PIKA_CHECK_BASE(pika::clause::_internal, Optional) else PIKA_CHECK_BASE(pika::clause::_internal, FollowedBy) else PIKA_CHECK_BASE(
-                pika::clause::_internal, NotFollowedBy) else PIKA_CHECK_BASE(pika::clause::_internal, Plus) else PIKA_CHECK_BASE(pika::clause::_internal, Char) else PIKA_CHECK_BASE(pika::clause::_internal, CharRange) else PIKA_CHECK_BASE(pika::clause, First) else PIKA_CHECK_BASE(pika::clause, Nothing) else PIKA_CHECK_BASE(pika::clause, Any) else return BaseType::
+                pika::clause::_internal, NotFollowedBy) else PIKA_CHECK_BASE(pika::clause::_internal, Plus) else PIKA_CHECK_BASE(pika::clause::_internal, Repeat) else PIKA_CHECK_BASE(pika::clause::_internal, Infix) else PIKA_CHECK_BASE(pika::clause::_internal, Precedence) else PIKA_CHECK_BASE(pika::clause::_internal, Char) else PIKA_CHECK_BASE(pika::clause::_internal, CharRange) else PIKA_CHECK_BASE(pika::clause::_internal, String) else PIKA_CHECK_BASE(pika::clause::_internal, CharSet) else PIKA_CHECK_BASE(pika::clause::_internal, Keywords) else PIKA_CHECK_BASE(pika::clause, First) else PIKA_CHECK_BASE(pika::clause, Nothing) else PIKA_CHECK_BASE(pika::clause, Any) else PIKA_CHECK_BASE(pika::clause, Cut) else return BaseType::
                 Error;
         }
     }
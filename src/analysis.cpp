@@ -0,0 +1,124 @@
+#include <pika/analysis.hpp>
+#include <typeindex>
+
+bool pika::analysis::FirstSet::operator==(const FirstSet& that) const noexcept
+{
+    return first == that.first && consuming == that.consuming &&
+        nullable == that.nullable && exact == that.exact;
+}
+
+bool pika::analysis::FirstSet::operator!=(const FirstSet& that) const noexcept
+{
+    return !(*this == that);
+}
+
+pika::analysis::FirstSet pika::analysis::FirstSet::anything() noexcept
+{
+    FirstSet result;
+    result.first.set();
+    result.consuming.set();
+    result.nullable = true;
+    return result;
+}
+
+pika::analysis::FirstSet
+pika::analysis::FirstSet::terminal(const SymbolSet& symbols) noexcept
+{
+    FirstSet result;
+    result.first = symbols;
+    result.consuming = symbols;
+    result.exact = true;
+    return result;
+}
+
+pika::analysis::FirstSet
+pika::analysis::FirstSet::lookahead(const SymbolSet& symbols) noexcept
+{
+    FirstSet result;
+    result.first = symbols;
+    result.nullable = true;
+    return result;
+}
+
+pika::analysis::FirstSet
+pika::analysis::FirstSet::then(const FirstSet& next) const noexcept
+{
+    if (!nullable)
+    {
+        auto result = *this;
+        result.exact = false;
+        return result;
+    }
+    /*
+     * Either this part consumes the symbol, or it matches empty and the next
+     * part has to match at the same symbol.
+     */
+    FirstSet result;
+    result.first = first & (consuming | next.first);
+    result.consuming = consuming | (first & next.consuming);
+    result.nullable = next.nullable;
+    return result;
+}
+
+pika::analysis::FirstSet
+pika::analysis::FirstSet::otherwise(const FirstSet& alternative) const noexcept
+{
+    FirstSet result;
+    result.first = first | alternative.first;
+    result.consuming = consuming | alternative.consuming;
+    result.nullable = nullable || alternative.nullable;
+    return result;
+}
+
+pika::analysis::Analysis::Analysis(const clause::Clause& toplevel)
+{
+    std::vector<const clause::Clause*> terminals;
+    std::vector<const clause::Clause*> nodes;
+    absl::flat_hash_set<std::type_index> visited;
+    toplevel.dfs_traversal(visited, terminals, nodes);
+
+    auto update = [&](const clause::Clause* clause) {
+        auto id = clause->clause_id();
+        if (id >= sets.size())
+        {
+            sets.resize(id + 1);
+        }
+        auto result = clause->first_set(*this);
+        if (result != sets[id])
+        {
+            sets[id] = result;
+            return true;
+        }
+        return false;
+    };
+    /*
+     * Terminals do not depend on anything; settling them first keeps the
+     * lookahead negations, which are not monotone, from oscillating.
+     */
+    for (auto i : terminals)
+    {
+        update(i);
+    }
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        for (auto i : nodes)
+        {
+            changed |= update(i);
+        }
+    }
+}
+
+pika::analysis::FirstSet
+pika::analysis::Analysis::operator[](const clause::Clause& clause) const
+{
+    auto id = clause.clause_id();
+    return id < sets.size() ? sets[id] : FirstSet{};
+}
+
+bool pika::analysis::Analysis::viable(
+    const clause::Clause& clause, size_t symbol) const
+{
+    auto id = clause.clause_id();
+    return id >= sets.size() || sets[id].first.test(symbol);
+}
@@ -1,3 +1,5 @@
+#include <atomic>
+#include <pika/analysis.hpp>
 #include <pika/clause.hpp>
 #include <pika/graph.hpp>
 #include <pika/memotable.hpp>
@@ -32,26 +34,44 @@ void pika::clause::Clause::dump(std::ostream& output) const
     dump_inner(output, visited);
 }
 
+size_t pika::clause::Clause::next_clause_id() noexcept
+{
+    static std::atomic<size_t> NEXT_ID{0};
+    return NEXT_ID.fetch_add(1, std::memory_order_relaxed);
+}
+
 bool pika::clause::Clause::active() const
 {
     return false;
 }
 
+bool pika::clause::Clause::memoizable() const
+{
+    return true;
+}
+
 std::shared_ptr<pika::memotable::Match> pika::clause::Clause::packrat_match(
     pika::memotable::MemoTable& table, size_t index) const
 {
     return nullptr;
 }
 
+std::shared_ptr<pika::memotable::Match> pika::clause::Clause::expand(
+    const pika::memotable::Match&,
+    size_t position,
+    pika::memotable::MemoTable& scratch) const
+{
+    return packrat_match(scratch, position);
+}
+
 std::shared_ptr<pika::memotable::Match> pika::clause::First::packrat_match(
     pika::memotable::MemoTable& table, size_t index) const
 {
     PIKA_CHECKED_MATCH(if (index == 0) {
-        return table[key] = std::make_shared<pika::memotable::Match>(
-                   key,
-                   0,
-                   0,
-                   std::vector<std::shared_ptr<pika::memotable::Match>>{});
+        return table.make_match(
+            pika::memotable::MemoKey(this->get_instance(), index),
+            0,
+            0);
     });
 }
 
@@ -68,15 +88,20 @@ void pika::clause::First::pika_match(pika::graph::ClauseTable& table) const
     }
 }
 
+pika::analysis::FirstSet
+pika::clause::First::first_set(const analysis::Analysis&) const
+{
+    return analysis::FirstSet::lookahead(~analysis::SymbolSet{});
+}
+
 std::shared_ptr<pika::memotable::Match> pika::clause::Nothing::packrat_match(
     pika::memotable::MemoTable& table, size_t index) const
 {
     PIKA_CHECKED_MATCH({
-        return table[key] = std::make_shared<pika::memotable::Match>(
-                   key,
-                   0,
-                   0,
-                   std::vector<std::shared_ptr<pika::memotable::Match>>{});
+        return table.make_match(
+            pika::memotable::MemoKey(this->get_instance(), index),
+            0,
+            0);
     });
 }
 
@@ -90,15 +115,20 @@ void pika::clause::Nothing::pika_match(pika::graph::ClauseTable& table) const
     table.try_add(this->get_instance(), 0, 0, {});
 }
 
+pika::analysis::FirstSet
+pika::clause::Nothing::first_set(const analysis::Analysis&) const
+{
+    return analysis::FirstSet::lookahead(~analysis::SymbolSet{});
+}
+
 std::shared_ptr<pika::memotable::Match> pika::clause::Any::packrat_match(
     pika::memotable::MemoTable& table, size_t index) const
 {
     PIKA_CHECKED_MATCH(if (!table.at_end(index)) {
-        return table[key] = std::make_shared<pika::memotable::Match>(
-                   key,
-                   1,
-                   0,
-                   std::vector<std::shared_ptr<pika::memotable::Match>>{});
+        return table.make_match(
+            pika::memotable::MemoKey(this->get_instance(), index),
+            1,
+            0);
     });
 }
 
@@ -115,6 +145,46 @@ void pika::clause::Any::pika_match(pika::graph::ClauseTable& table) const
     }
 }
 
+pika::analysis::FirstSet
+pika::clause::Any::first_set(const analysis::Analysis&) const
+{
+    auto bytes = ~analysis::SymbolSet{};
+    bytes.reset(analysis::END_OF_INPUT);
+    return analysis::FirstSet::terminal(bytes);
+}
+
+std::shared_ptr<pika::memotable::Match> pika::clause::Cut::packrat_match(
+    pika::memotable::MemoTable& table, size_t index) const
+{
+    PIKA_CHECKED_MATCH({
+        table.packrat_cut(index);
+        return table.make_match(
+            pika::memotable::MemoKey(this->get_instance(), index),
+            0,
+            0);
+    });
+}
+
+pika::type_utils::BaseType pika::clause::Cut::get_base_type() const noexcept
+{
+    return pika::type_utils::BaseType::Cut;
+}
+
+void pika::clause::Cut::pika_match(pika::graph::ClauseTable& table) const
+{
+    table.try_add(this->get_instance(), 0, 0, {});
+}
+
+pika::analysis::FirstSet
+pika::clause::Cut::first_set(const analysis::Analysis&) const
+{
+    /*
+     * A cut commits its choice even if the rest of its alternative fails, so
+     * an alternative holding one must never be skipped.
+     */
+    return analysis::FirstSet::anything();
+}
+
 pika::type_utils::BaseType pika::clause::Clause::get_base_type() const noexcept
 {
     return pika::type_utils::BaseType::Error;
@@ -122,6 +192,14 @@ pika::type_utils::BaseType pika::clause::Clause::get_base_type() const noexcept
 
 void pika::clause::Clause::mark_seeds(pika::graph::ClauseTable& table) const {}
 
+void pika::clause::Clause::sub_clauses(std::vector<const Clause*>&) const {}
+
+pika::analysis::FirstSet
+pika::clause::Clause::first_set(const analysis::Analysis&) const
+{
+    return analysis::FirstSet::anything();
+}
+
 pika::type_utils::BaseType
 pika::clause::_internal::Char::get_base_type() const noexcept
 {
@@ -134,6 +212,42 @@ pika::clause::_internal::CharRange::get_base_type() const noexcept
     return pika::type_utils::BaseType::CharRange;
 }
 
+pika::type_utils::BaseType
+pika::clause::_internal::String::get_base_type() const noexcept
+{
+    return pika::type_utils::BaseType::String;
+}
+
+pika::type_utils::BaseType
+pika::clause::_internal::CharSet::get_base_type() const noexcept
+{
+    return pika::type_utils::BaseType::CharSet;
+}
+
+pika::type_utils::BaseType
+pika::clause::_internal::Keywords::get_base_type() const noexcept
+{
+    return pika::type_utils::BaseType::Keywords;
+}
+
+pika::type_utils::BaseType
+pika::clause::_internal::Repeat::get_base_type() const noexcept
+{
+    return pika::type_utils::BaseType::Repeat;
+}
+
+pika::type_utils::BaseType
+pika::clause::_internal::Infix::get_base_type() const noexcept
+{
+    return pika::type_utils::BaseType::Infix;
+}
+
+pika::type_utils::BaseType
+pika::clause::_internal::Precedence::get_base_type() const noexcept
+{
+    return pika::type_utils::BaseType::Precedence;
+}
+
 pika::type_utils::BaseType
 pika::clause::_internal::NotFollowedBy::get_base_type() const noexcept
 {
@@ -0,0 +1,546 @@
+#include <absl/container/flat_hash_map.h>
+#include <algorithm>
+#include <bitset>
+#include <limits>
+#include <pika/dfa.hpp>
+#include <pika/type_utils.hpp>
+#include <stdexcept>
+
+using Bytes = std::bitset<256>;
+
+namespace
+{
+    /*
+     * The regular expression a clause stands for. Literals are spelled out
+     * as sequences of bytes; a repetition keeps its bounds.
+     */
+    struct Regex
+    {
+        enum Kind
+        {
+            Byte,
+            Seq,
+            Ord,
+            Optional,
+            Asterisks,
+            Plus,
+            Repeat
+        };
+
+        Kind kind = Byte;
+        Bytes bytes{};
+        std::vector<Regex> children{};
+        size_t min = 0;
+        size_t max = 0;
+        /*
+         * NFA states needed to build it, to bail out of huge repetitions
+         * before building anything.
+         */
+        size_t size = 1;
+    };
+
+    /*
+     * Thompson automaton: every state either consumes one of `bytes` and
+     * moves to `next`, or moves on without input to any of `epsilon`.
+     */
+    struct Nfa
+    {
+        struct State
+        {
+            Bytes bytes;
+            uint32_t next = 0;
+            std::vector<uint32_t> epsilon;
+        };
+
+        std::vector<State> states;
+
+        uint32_t add();
+
+        /*
+         * Builds `regex` from state `start` and returns the state it ends
+         * in.
+         */
+        uint32_t build(const Regex& regex, uint32_t start);
+
+        /*
+         * Extends `set` by the states reachable without input and sorts it.
+         */
+        void closure(std::vector<uint32_t>& set) const;
+    };
+}
+
+constexpr size_t MAX_NFA_STATES = 4096;
+
+static std::optional<Regex> to_regex(
+    const pika::clause::Clause* clause,
+    const pika::analysis::Analysis& analysis,
+    std::vector<const pika::clause::Clause*>& stack)
+{
+    using pika::type_utils::BaseType;
+    if (std::find(stack.begin(), stack.end(), clause) != stack.end())
+    {
+        return std::nullopt;
+    }
+    Regex result{};
+    switch (clause->get_base_type())
+    {
+        case BaseType::Char:
+        case BaseType::CharRange:
+        case BaseType::CharSet:
+        case BaseType::Any:
+        {
+            auto first = analysis[*clause];
+            if (!first.exact || first.nullable)
+            {
+                return std::nullopt;
+            }
+            result.kind = Regex::Byte;
+            for (size_t i = 0; i < 256; ++i)
+            {
+                result.bytes[i] = first.first[i];
+            }
+            return result;
+        }
+        case BaseType::String:
+        {
+            auto literal =
+                static_cast<const pika::clause::_internal::String*>(clause)
+                    ->literal();
+            result.kind = Regex::Seq;
+            result.size = 0;
+            for (char c : literal)
+            {
+                Regex byte{};
+                byte.bytes.set(static_cast<unsigned char>(c));
+                result.children.push_back(byte);
+                result.size += 1;
+            }
+            return result;
+        }
+        case BaseType::Seq:
+            result.kind = Regex::Seq;
+            break;
+        case BaseType::Ord:
+            result.kind = Regex::Ord;
+            break;
+        case BaseType::Optional:
+            result.kind = Regex::Optional;
+            break;
+        case BaseType::Asterisks:
+            result.kind = Regex::Asterisks;
+            break;
+        case BaseType::Plus:
+            result.kind = Regex::Plus;
+            break;
+        case BaseType::Repeat:
+        {
+            auto repeat =
+                static_cast<const pika::clause::_internal::Repeat*>(clause);
+            result.kind = Regex::Repeat;
+            result.min = repeat->minimum();
+            result.max = repeat->maximum();
+            break;
+        }
+        default:
+            return std::nullopt;
+    }
+    std::vector<const pika::clause::Clause*> children;
+    clause->sub_clauses(children);
+    stack.push_back(clause);
+    for (auto i : children)
+    {
+        auto child = to_regex(i, analysis, stack);
+        if (!child)
+        {
+            return std::nullopt;
+        }
+        result.size += result.kind == Regex::Repeat ?
+            child->size * result.max :
+            child->size;
+        if (result.size > MAX_NFA_STATES)
+        {
+            return std::nullopt;
+        }
+        result.children.push_back(std::move(*child));
+    }
+    stack.pop_back();
+    return result;
+}
+
+static bool nullable(const Regex& regex)
+{
+    switch (regex.kind)
+    {
+        case Regex::Byte:
+            return false;
+        case Regex::Seq:
+            return std::all_of(
+                regex.children.begin(), regex.children.end(), nullable);
+        case Regex::Ord:
+            return std::any_of(
+                regex.children.begin(), regex.children.end(), nullable);
+        case Regex::Plus:
+            return nullable(regex.children[0]);
+        case Regex::Repeat:
+            return regex.min == 0 || nullable(regex.children[0]);
+        default:
+            return true;
+    }
+}
+
+static Bytes first(const Regex& regex)
+{
+    Bytes result;
+    switch (regex.kind)
+    {
+        case Regex::Byte:
+            return regex.bytes;
+        case Regex::Seq:
+            for (auto& i : regex.children)
+            {
+                result |= first(i);
+                if (!nullable(i))
+                {
+                    break;
+                }
+            }
+            return result;
+        case Regex::Ord:
+            for (auto& i : regex.children)
+            {
+                result |= first(i);
+            }
+            return result;
+        default:
+            return first(regex.children[0]);
+    }
+}
+
+/*
+ * Whether every choice of the PEG reading of `regex`, followed by something
+ * starting with one of `follow`, is decided by the next byte. PEG matching
+ * never revisits a choice once made; when no other choice could have
+ * consumed the byte, it finds the longest match like the automaton does.
+ */
+static bool deterministic(const Regex& regex, const Bytes& follow)
+{
+    switch (regex.kind)
+    {
+        case Regex::Byte:
+            return true;
+        case Regex::Seq:
+        {
+            auto next = follow;
+            for (auto i = regex.children.rbegin(); i != regex.children.rend();
+                 ++i)
+            {
+                if (!deterministic(*i, next))
+                {
+                    return false;
+                }
+                next = nullable(*i) ? first(*i) | next : first(*i);
+            }
+            return true;
+        }
+        case Regex::Ord:
+        {
+            Bytes seen;
+            for (size_t i = 0; i < regex.children.size(); ++i)
+            {
+                auto& child = regex.children[i];
+                auto symbols = first(child);
+                /*
+                 * An empty match ends the choice, so only the last
+                 * alternative may have one.
+                 */
+                if ((seen & symbols).any() ||
+                    (nullable(child) && i + 1 != regex.children.size()) ||
+                    !deterministic(child, follow))
+                {
+                    return false;
+                }
+                seen |= symbols;
+            }
+            return !nullable(regex) || (seen & follow).none();
+        }
+        default:
+        {
+            auto& child = regex.children[0];
+            auto symbols = first(child);
+            bool optional =
+                regex.kind != Regex::Repeat || regex.min < regex.max;
+            bool repeated = regex.kind != Regex::Optional &&
+                (regex.kind != Regex::Repeat || regex.max > 1);
+            return !nullable(child) &&
+                (!optional || (symbols & follow).none()) &&
+                deterministic(child, repeated ? symbols | follow : follow);
+        }
+    }
+}
+
+uint32_t Nfa::add()
+{
+    states.emplace_back();
+    return static_cast<uint32_t>(states.size() - 1);
+}
+
+uint32_t Nfa::build(const Regex& regex, uint32_t start)
+{
+    switch (regex.kind)
+    {
+        case Regex::Byte:
+        {
+            auto end = add();
+            states[start].bytes = regex.bytes;
+            states[start].next = end;
+            return end;
+        }
+        case Regex::Seq:
+            for (auto& i : regex.children)
+            {
+                start = build(i, start);
+            }
+            return start;
+        case Regex::Ord:
+        {
+            auto end = add();
+            for (auto& i : regex.children)
+            {
+                auto branch = add();
+                states[start].epsilon.push_back(branch);
+                states[build(i, branch)].epsilon.push_back(end);
+            }
+            return end;
+        }
+        case Regex::Optional:
+        {
+            auto end = build(regex.children[0], start);
+            states[start].epsilon.push_back(end);
+            return end;
+        }
+        case Regex::Asterisks:
+        case Regex::Plus:
+        {
+            auto body = add();
+            auto end = add();
+            states[start].epsilon.push_back(body);
+            if (regex.kind == Regex::Asterisks)
+            {
+                states[start].epsilon.push_back(end);
+            }
+            auto last = build(regex.children[0], body);
+            states[last].epsilon.push_back(body);
+            states[last].epsilon.push_back(end);
+            return end;
+        }
+        case Regex::Repeat:
+        {
+            for (size_t i = 0; i < regex.min; ++i)
+            {
+                start = build(regex.children[0], start);
+            }
+            auto end = add();
+            for (size_t i = regex.min; i < regex.max; ++i)
+            {
+                states[start].epsilon.push_back(end);
+                start = build(regex.children[0], start);
+            }
+            states[start].epsilon.push_back(end);
+            return end;
+        }
+    }
+    return start;
+}
+
+void Nfa::closure(std::vector<uint32_t>& set) const
+{
+    std::vector<bool> seen(states.size());
+    std::vector<uint32_t> stack = set;
+    for (auto i : set)
+    {
+        seen[i] = true;
+    }
+    while (!stack.empty())
+    {
+        auto current = stack.back();
+        stack.pop_back();
+        for (auto i : states[current].epsilon)
+        {
+            if (!seen[i])
+            {
+                seen[i] = true;
+                set.push_back(i);
+                stack.push_back(i);
+            }
+        }
+    }
+    std::sort(set.begin(), set.end());
+}
+
+std::optional<pika::dfa::Dfa> pika::dfa::Dfa::compile(
+    const clause::Clause& clause, const analysis::Analysis& analysis)
+{
+    std::vector<const clause::Clause*> stack;
+    auto regex = to_regex(clause.get_instance(), analysis, stack);
+    if (!regex || !deterministic(*regex, Bytes{}))
+    {
+        return std::nullopt;
+    }
+    Nfa nfa;
+    auto start = nfa.add();
+    auto accept = nfa.build(*regex, start);
+
+    /*
+     * Subset construction, a DFA state per set of NFA states reached.
+     */
+    Dfa result;
+    std::vector<std::vector<uint32_t>> sets{{}, {start}};
+    nfa.closure(sets[1]);
+    absl::flat_hash_map<std::vector<uint32_t>, uint32_t> ids{
+        {sets[0], 0}, {sets[1], 1}};
+    for (size_t current = 0; current < sets.size(); ++current)
+    {
+        if (sets.size() > MAX_STATES)
+        {
+            return std::nullopt;
+        }
+        auto& row = result.transitions.emplace_back();
+        result.accepting.push_back(std::binary_search(
+            sets[current].begin(), sets[current].end(), accept));
+        for (size_t byte = 0; byte < 256; ++byte)
+        {
+            std::vector<uint32_t> next;
+            for (auto i : sets[current])
+            {
+                if (nfa.states[i].bytes[byte])
+                {
+                    next.push_back(nfa.states[i].next);
+                }
+            }
+            nfa.closure(next);
+            auto found = ids.try_emplace(next, sets.size());
+            if (found.second)
+            {
+                sets.push_back(std::move(next));
+            }
+            row[byte] = found.first->second;
+        }
+    }
+    return result;
+}
+
+size_t pika::dfa::Dfa::match(
+    std::string_view input, size_t index, size_t& depends) const
+{
+    size_t longest = accepting[1] ? 0 : NO_MATCH;
+    uint32_t state = 1;
+    auto position = index;
+    while (state != 0 && position < input.size())
+    {
+        auto byte = static_cast<unsigned char>(input[position]);
+        state = transitions[state][byte];
+        position += 1;
+        if (accepting[state])
+        {
+            longest = position - index;
+        }
+    }
+    /*
+     * An automaton still alive at the end of input depends on the end.
+     */
+    depends = position - index + (state != 0);
+    return longest;
+}
+
+size_t pika::dfa::Dfa::match(
+    std::string_view input, size_t index, size_t& depends, Scans& scans) const
+{
+    if (scans.heads.size() != input.size() + 1)
+    {
+        scans.clear();
+        scans.heads.assign(input.size() + 1, 0);
+    }
+    auto& path = scans.path;
+    path.clear();
+    uint32_t state = 1;
+    auto position = index;
+    size_t longest = NO_MATCH;
+    size_t stop = position;
+    while (state != 0)
+    {
+        if (auto visit = scans.find(position, state))
+        {
+            longest = visit->longest;
+            stop = visit->stop;
+            break;
+        }
+        path.push_back(state);
+        if (position == input.size())
+        {
+            stop = position + 1;
+            break;
+        }
+        auto byte = static_cast<unsigned char>(input[position]);
+        state = transitions[state][byte];
+        position += 1;
+        stop = position;
+    }
+    for (auto i = path.size(); i > 0; --i)
+    {
+        auto at = index + i - 1;
+        if (longest == NO_MATCH && accepting[path[i - 1]])
+        {
+            longest = at;
+        }
+        scans.add(at, path[i - 1], longest, stop);
+    }
+    depends = stop - index;
+    return longest == NO_MATCH ? NO_MATCH : longest - index;
+}
+
+size_t pika::dfa::Dfa::states() const noexcept
+{
+    return transitions.size();
+}
+
+const pika::dfa::Scans::Visit*
+pika::dfa::Scans::find(size_t position, uint32_t state) const noexcept
+{
+    for (auto i = heads[position]; i != 0; i = visits[i - 1].next)
+    {
+        if (visits[i - 1].state == state)
+        {
+            return &visits[i - 1];
+        }
+    }
+    return nullptr;
+}
+
+void pika::dfa::Scans::add(
+    size_t position, uint32_t state, size_t longest, size_t stop)
+{
+    if (visits.size() >= std::numeric_limits<uint32_t>::max())
+    {
+        throw std::length_error("too many automaton visits to record");
+    }
+    visits.push_back({state, heads[position], longest, stop});
+    heads[position] = static_cast<uint32_t>(visits.size());
+}
+
+size_t pika::dfa::Scans::size() const noexcept
+{
+    return visits.size();
+}
+
+size_t pika::dfa::Scans::bytes() const noexcept
+{
+    return heads.capacity() * sizeof(uint32_t) +
+        visits.capacity() * sizeof(Visit) + path.capacity() * sizeof(uint32_t);
+}
+
+void pika::dfa::Scans::clear() noexcept
+{
+    heads.clear();
+    visits.clear();
+    path.clear();
+}
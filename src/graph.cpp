@@ -1,11 +1,12 @@
 //
 // Created by schrodinger on 10/24/20.
 //
+#include <algorithm>
+#include <limits>
 #include <pika/graph.hpp>
-
-#ifdef PIKA_DEBUG
-#    include <iostream>
-#endif
+#include <stdexcept>
+#include <tuple>
+#include <utility>
 
 pika::graph::TableEntry::TableEntry(
     const pika::clause::Clause* instance, size_t topological_order)
@@ -21,8 +22,102 @@ pika::graph::ClauseTable::ClauseTable(
   terminals(std::move(terminals)),
   memo_table(target),
   current_pos(target.size() + 1),
-  toplevel(toplevel)
-{}
+  toplevel(toplevel),
+  reach(target.size() + 1)
+{
+    std::vector<const pika::clause::Clause*> all(
+        this->terminals.begin(), this->terminals.end());
+    all.insert(all.end(), this->specials.begin(), this->specials.end());
+    seeds.assign(analysis::SYMBOLS, all);
+    memo_table.account(reach.bytes());
+}
+
+size_t pika::graph::ColumnQueue::capacity() const noexcept
+{
+    return c.capacity();
+}
+
+pika::graph::Reach::Reach(size_t keys)
+{
+    size_t capacity = 1;
+    while (capacity < keys)
+    {
+        capacity *= 2;
+    }
+    ends.assign(2 * capacity, 0);
+}
+
+size_t pika::graph::Reach::extent(size_t key) const noexcept
+{
+    auto end = ends[ends.size() / 2 + key];
+    return end > key ? end - key : 0;
+}
+
+void pika::graph::Reach::set(size_t key, size_t extent)
+{
+    auto node = ends.size() / 2 + key;
+    ends[node] = key + extent;
+    for (node /= 2; node > 0; node /= 2)
+    {
+        ends[node] = std::max(ends[2 * node], ends[2 * node + 1]);
+    }
+}
+
+void pika::graph::Reach::grow(size_t keys)
+{
+    auto capacity = ends.size() / 2;
+    if (keys <= capacity)
+    {
+        return;
+    }
+    while (capacity < keys)
+    {
+        capacity *= 2;
+    }
+    std::vector<size_t> grown(2 * capacity, 0);
+    std::copy(
+        ends.begin() + ends.size() / 2, ends.end(), grown.begin() + capacity);
+    for (auto i = capacity - 1; i > 0; --i)
+    {
+        grown[i] = std::max(grown[2 * i], grown[2 * i + 1]);
+    }
+    ends = std::move(grown);
+}
+
+void pika::graph::Reach::crossing(
+    size_t first,
+    size_t last,
+    size_t threshold,
+    std::vector<size_t>& output) const
+{
+    auto capacity = ends.size() / 2;
+    /*
+     * Nodes with the range of keys below them.
+     */
+    std::vector<std::tuple<size_t, size_t, size_t>> stack{{1, 0, capacity}};
+    while (!stack.empty())
+    {
+        auto [node, low, high] = stack.back();
+        stack.pop_back();
+        if (ends[node] <= threshold || high <= first || last <= low)
+        {
+            continue;
+        }
+        if (node >= capacity)
+        {
+            output.push_back(low);
+            continue;
+        }
+        auto middle = (low + high) / 2;
+        stack.emplace_back(2 * node, low, middle);
+        stack.emplace_back(2 * node + 1, middle, high);
+    }
+}
+
+size_t pika::graph::Reach::bytes() const noexcept
+{
+    return ends.capacity() * sizeof(size_t);
+}
 
 char pika::graph::ClauseTable::get_current() const
 {
@@ -31,18 +126,93 @@ char pika::graph::ClauseTable::get_current() const
         memo_table.target[current_pos - 1];
 }
 
+size_t pika::graph::ClauseTable::current_symbol() const
+{
+    return eof() ? analysis::END_OF_INPUT :
+                   static_cast<unsigned char>(get_current());
+}
+
+const pika::clause::Clause*
+pika::graph::ClauseTable::resolve(const clause::Clause* clause) const
+{
+    auto id = clause->clause_id();
+    return id < canonical.size() ? canonical[id] : clause;
+}
+
+pika::memotable::MemoTable::const_iterator
+pika::graph::ClauseTable::lookup(const clause::Clause* clause, size_t offset)
+{
+    clause = resolve(clause);
+    auto position = current_pos - 1 + offset;
+    auto key = memo_table.key_position(position);
+    if (offset != 0)
+    {
+        column_end = std::max(column_end, position + reach.extent(key));
+    }
+    auto found = memo_table.find(memotable::MemoKey{clause, key});
+    if (found != memo_table.end())
+    {
+        memo_table.counters.hits += 1;
+        PIKA_STATISTIC(memo_table, clause, hits);
+    }
+    else
+    {
+        PIKA_STATISTIC(memo_table, clause, misses);
+    }
+    return found;
+}
+
+void pika::graph::ClauseTable::extend_reach(size_t length)
+{
+    auto end = std::min(current_pos - 1 + length, memo_table.target.size() + 1);
+    column_end = std::max(column_end, end);
+}
+
 void pika::graph::ClauseTable::add_candidates(std::type_index idx)
 {
+    auto symbol = current_symbol();
     for (auto i : this->at(idx).candidates)
     {
-#ifdef PIKA_DEBUG
-        std::cout << "added: "
-                  << abi::__cxa_demangle(
-                         typeid(*i).name(), nullptr, nullptr, nullptr)
-                  << ", at: " << this->current_pos - 1 << std::endl;
-#endif
-        this->column.template emplace(
-            this->template at(typeid(*i)).topological_order, i);
+        auto& entry = this->template at(typeid(*i));
+        if (!entry.first.test(symbol))
+        {
+            continue;
+        }
+        this->column.template emplace(entry.topological_order, i);
+        memo_table.counters.pushes += 1;
+        PIKA_STATISTIC(memo_table, i, pushes);
+    }
+}
+
+void pika::graph::ClauseTable::evaluate(const clause::Clause* clause)
+{
+    auto id = clause->clause_id();
+    if (id >= compiled.size() || !compiled[id])
+    {
+        clause->pika_match(*this);
+        return;
+    }
+    size_t depends = 0;
+    size_t length;
+    if (id < scans.size())
+    {
+        auto& scan = scans[id];
+        auto before = scan.bytes();
+        length = compiled[id]->match(
+            memo_table.target, current_pos - 1, depends, scan);
+        memo_table.account(
+            static_cast<ptrdiff_t>(scan.bytes()) -
+            static_cast<ptrdiff_t>(before));
+    }
+    else
+    {
+        length =
+            compiled[id]->match(memo_table.target, current_pos - 1, depends);
+    }
+    extend_reach(depends);
+    if (length != dfa::Dfa::NO_MATCH)
+    {
+        try_add(clause, length, memotable::Match::UNEXPANDED, {});
     }
 }
 
@@ -51,36 +221,50 @@ bool pika::graph::ClauseTable::eof() const
     return memo_table.target.size() < current_pos;
 }
 
+bool pika::graph::ClauseTable::improves(
+    const clause::Clause* clause, size_t length, size_t fst_idx) const
+{
+    auto found = memo_table.find(
+        memotable::MemoKey{clause, memo_table.key_position(current_pos - 1)});
+    return found == memo_table.end() ||
+        found->second->is_improved_by(length, fst_idx);
+}
+
 void pika::graph::ClauseTable::try_add(
     const pika::clause::Clause* tag,
     size_t length,
     size_t fst_idx,
-    std::vector<std::shared_ptr<memotable::Match>> subs)
-{
-    auto key = memotable::MemoKey{tag, current_pos - 1};
-#ifdef PIKA_DEBUG
-    std::cout << "matched "
-              << abi::__cxa_demangle(
-                     typeid(*tag).name(), nullptr, nullptr, nullptr)
-              << ", at " << this->current_pos - 1 << ", content: "
-              << this->memo_table.target.substr(
-                     this->current_pos - 1, this->current_pos - 1 + length)
-              << ", subs_len: " << subs.size() << ", length: " << length;
-#endif
-    auto match = memotable::Match{key, length, fst_idx, std::move(subs)};
-    if (!memo_table.contains(key) || match.is_better_than(*memo_table.at(key)))
+    absl::Span<const std::shared_ptr<memotable::Match>> subs)
+{
+    auto key =
+        memotable::MemoKey{tag, memo_table.key_position(current_pos - 1)};
+    auto found = memo_table.find(key);
+    PIKA_STATISTIC(memo_table, tag, matches);
+    if (found == memo_table.end() ||
+        found->second->is_improved_by(length, fst_idx))
     {
-#ifdef PIKA_DEBUG
-        std::cout << ", this is a better match" << std::endl;
-#endif
-        memo_table[key] = std::make_shared<memotable::Match>(std::move(match));
+        PIKA_STATISTIC(memo_table, tag, improvements);
+        auto stored = length_only && !replaying ?
+            memo_table.make_match(key, length, fst_idx) :
+            memo_table.make_match(key, length, fst_idx, subs);
+        if (found == memo_table.end())
+        {
+            auto capacity = memo_table.capacity();
+            memo_table.emplace(key, std::move(stored));
+            memo_table.account(
+                (memo_table.capacity() - capacity) *
+                (sizeof(memotable::MemoTable::value_type) + 1));
+        }
+        else
+        {
+            found->second = std::move(stored);
+        }
+        memo_table.counters.insertions += 1;
         add_candidates(typeid(*tag));
     }
     else
     {
-#ifdef PIKA_DEBUG
-        std::cout << ", this is not a better match" << std::endl;
-#endif
+        PIKA_STATISTIC(memo_table, tag, rejections);
     }
 }
 
@@ -89,44 +273,495 @@ bool pika::graph::ClauseTable::match_column()
     if (current_pos == 0)
         return false;
     assert(this->column.empty());
-    for (auto i : terminals)
-    {
-        column.emplace(this->at(typeid(*i)).topological_order, i);
-    }
-    for (auto i : specials)
+    column_end = current_pos;
+    memo_table.counters.columns += 1;
+    const auto& seeded = seeds[current_symbol()];
+    for (auto i : seeded)
     {
         column.emplace(this->at(typeid(*i)).topological_order, i);
+        PIKA_STATISTIC(memo_table, i, pushes);
     }
+    memo_table.counters.pushes += seeded.size();
+    auto tracer = memo_table.tracer;
+    auto start = tracer ? limits::Clock::now() : limits::Clock::time_point{};
+    auto evaluations = memo_table.counters.evaluations;
+    auto queue_depth = column.size();
+#ifdef PIKA_STATISTICS
+    auto previous = ParsingItem{};
+#endif
     while (!column.empty())
     {
+#ifdef PIKA_STATISTICS
+        if (column.top() == previous)
+        {
+            PIKA_STATISTIC(memo_table, previous.second, duplicates);
+        }
+        previous = column.top();
+#endif
         const clause::Clause* top = column.top().second;
         column.pop();
-#ifdef PIKA_DEBUG
-        std::cout << "trying to parse: "
-                  << abi::__cxa_demangle(
-                         typeid(*top).name(), nullptr, nullptr, nullptr)
-                  << ", at: " << this->current_pos - 1 << std::endl;
-#endif
-        top->pika_match(*this);
+        memo_table.limits.tick();
+        memo_table.counters.evaluations += 1;
+        PIKA_STATISTIC(memo_table, top, evaluations);
+        evaluate(top);
+        if (tracer)
+        {
+            queue_depth = std::max(queue_depth, column.size());
+        }
+    }
+    if (tracer)
+    {
+        tracer->column(
+            current_pos - 1,
+            start,
+            queue_depth,
+            memo_table.counters.evaluations - evaluations);
+    }
+    if (column.capacity() * sizeof(ParsingItem) != queue_bytes)
+    {
+        auto bytes = column.capacity() * sizeof(ParsingItem);
+        memo_table.account(
+            static_cast<ptrdiff_t>(bytes) -
+            static_cast<ptrdiff_t>(queue_bytes));
+        queue_bytes = bytes;
     }
+    reach.set(
+        memo_table.key_position(current_pos - 1),
+        column_end - (current_pos - 1));
     current_pos -= 1;
     return true;
 }
 
+bool pika::graph::Progress::finished() const noexcept
+{
+    return matched_columns == total_columns;
+}
+
 std::shared_ptr<pika::memotable::Match> pika::graph::ClauseTable::match()
 {
-    while (match_column())
+    step(std::numeric_limits<size_t>::max());
+    return result();
+}
+
+pika::graph::Progress pika::graph::ClauseTable::step(size_t max_columns)
+{
+    for (size_t i = 0; i < max_columns && match_column(); ++i)
+        ;
+    return progress();
+}
+
+pika::graph::Progress
+pika::graph::ClauseTable::step(limits::Clock::duration max_time)
+{
+    auto deadline = limits::Clock::now() + max_time;
+    while (match_column() && limits::Clock::now() < deadline)
         ;
-    auto key = memotable::MemoKey{toplevel, 0};
-    if (memo_table.contains(key))
+    return progress();
+}
+
+pika::graph::Progress pika::graph::ClauseTable::progress() const noexcept
+{
+    auto total = memo_table.target.size() + 1;
+    return {total - current_pos, total};
+}
+
+std::shared_ptr<pika::memotable::Match> pika::graph::ClauseTable::result()
+{
+    auto key = memotable::MemoKey{toplevel, memo_table.key_position(0)};
+    if (current_pos != 0 || !memo_table.contains(key))
+    {
+        return nullptr;
+    }
+    if (length_only)
+    {
+        return rebuild(replay(toplevel, 0));
+    }
+    return memo_table.at(key);
+}
+
+/*
+ * Remove the entries at `column` from the memo table, passing each to
+ * `output` first.
+ */
+template<typename F>
+static void take(pika::graph::ClauseTable& table, size_t column, F&& output)
+{
+    auto& memo = table.memo_table;
+    auto position = memo.key_position(column);
+    for (const auto& i : table)
     {
-        return memo_table.at(key);
+        auto clause = i.second.instance;
+        if (table.resolve(clause) != clause)
+        {
+            continue;
+        }
+        auto found = memo.find(pika::memotable::MemoKey{clause, position});
+        if (found != memo.end())
+        {
+            output(std::move(found->second));
+            memo.erase(found);
+        }
     }
-    return nullptr;
+}
+
+std::shared_ptr<pika::memotable::Match>
+pika::graph::ClauseTable::replay(const clause::Clause* clause, size_t position)
+{
+    auto capacity = memo_table.capacity();
+    std::vector<std::shared_ptr<memotable::Match>> saved;
+    take(*this, position, [&](std::shared_ptr<memotable::Match> match) {
+        saved.push_back(std::move(match));
+    });
+    auto pos = current_pos;
+    auto end = column_end;
+    auto counters = memo_table.counters;
+    auto tracer = std::exchange(memo_table.tracer, nullptr);
+    replaying = true;
+    current_pos = position + 1;
+    match_column();
+    auto found = memo_table.find(
+        memotable::MemoKey{clause, memo_table.key_position(position)});
+    auto result = found != memo_table.end() ? found->second : nullptr;
+    take(*this, position, [](std::shared_ptr<memotable::Match>) {});
+    for (auto& i : saved)
+    {
+        auto key = i->key;
+        memo_table.emplace(key, std::move(i));
+    }
+    replaying = false;
+    current_pos = pos;
+    column_end = end;
+    memo_table.counters = counters;
+    memo_table.tracer = tracer;
+    memo_table.account(
+        (static_cast<ptrdiff_t>(memo_table.capacity()) -
+         static_cast<ptrdiff_t>(capacity)) *
+        static_cast<ptrdiff_t>(sizeof(memotable::MemoTable::value_type) + 1));
+    return result;
+}
+
+std::shared_ptr<pika::memotable::Match> pika::graph::ClauseTable::rebuild(
+    const std::shared_ptr<memotable::Match>& match)
+{
+    if (match->sub_matches.empty())
+    {
+        return match;
+    }
+    std::vector<std::shared_ptr<memotable::Match>> subs;
+    subs.reserve(match->sub_matches.size());
+    std::vector<const clause::Clause*> children;
+    for (auto sub : match->sub_matches)
+    {
+        /*
+         * Precedence tails leave a gap where a chain is missing.
+         */
+        if (!sub)
+        {
+            subs.push_back(nullptr);
+            continue;
+        }
+        /*
+         * Entries of the same column come from the replay that found
+         * `match` and kept their sub-matches. Those of later columns lost
+         * theirs, unless they never had any: terminals, and clauses
+         * matched by a DFA, which TreeNode expands on its own.
+         */
+        auto tag = sub->key.tag;
+        auto id = tag->clause_id();
+        children.clear();
+        tag->sub_clauses(children);
+        if (sub->key.start_position != match->key.start_position &&
+            sub->sub_matches.empty() && !children.empty() &&
+            (id >= compiled.size() || !compiled[id]))
+        {
+            if (auto found = replay(tag, memo_table.position(sub->key)))
+            {
+                sub = std::move(found);
+            }
+        }
+        subs.push_back(rebuild(sub));
+    }
+    return memo_table.make_match(
+        match->key, match->length, match->sub_fst_idx, std::move(subs));
+}
+
+std::shared_ptr<pika::memotable::Match>
+pika::graph::ClauseTable::reparse(const Edit& edit, std::string_view updated)
+{
+    auto original = memo_table.target.size();
+    if (current_pos != 0)
+    {
+        throw std::logic_error("reparse needs a table that finished matching");
+    }
+    if (length_only)
+    {
+        throw std::logic_error("length-only tables cannot be reparsed");
+    }
+    if (edit.start > edit.end || edit.end > original)
+    {
+        throw std::invalid_argument("edit out of the range of the target");
+    }
+    if (updated.size() + edit.end - edit.start !=
+        original + edit.replacement.size())
+    {
+        throw std::invalid_argument("updated buffer does not match the edit");
+    }
+    auto keys = memo_table.key_runs.empty() ? original + 1 :
+                                              memo_table.next_key;
+    auto limit = std::numeric_limits<uint32_t>::max();
+    if (updated.size() >= limit || edit.replacement.size() + 1 > limit - keys)
+    {
+        throw std::length_error("edits do not fit the 32-bit memo keys");
+    }
+    auto capacity = memo_table.capacity();
+    auto before = reach.bytes();
+    for (const auto& i : scans)
+    {
+        before += i.bytes();
+    }
+
+    /*
+     * Columns to the left of the edit only need to be matched again if they
+     * looked at anything from the edit start onwards, which the reach of
+     * each key run left of it tells. The first column is special: `First`
+     * only matches there, so the column that ends up first after an edit
+     * at the start is matched again as well.
+     */
+    std::vector<size_t> affected;
+    auto runs = memo_table.key_runs;
+    if (runs.empty())
+    {
+        runs.push_back({0, 0});
+    }
+    for (auto i = runs.size(); i-- > 0;)
+    {
+        auto run = runs[i];
+        if (run.position >= edit.start)
+        {
+            continue;
+        }
+        auto end = i + 1 < runs.size() ?
+            std::min(runs[i + 1].position, edit.start) :
+            edit.start;
+        auto found = affected.size();
+        reach.crossing(
+            run.key,
+            run.key + (end - run.position),
+            run.key + (edit.start - run.position),
+            affected);
+        for (auto j = found; j < affected.size(); ++j)
+        {
+            affected[j] = run.position + (affected[j] - run.key);
+        }
+    }
+    auto extra = edit.start == 0 ? 1 : 0;
+    auto removed = edit.end + extra - edit.start;
+    auto inserted = edit.replacement.size() + extra;
+    auto drop = [](std::shared_ptr<memotable::Match>) {};
+    for (auto i : affected)
+    {
+        take(*this, i, drop);
+    }
+    for (size_t i = 0; i < removed; ++i)
+    {
+        take(*this, edit.start + i, drop);
+    }
+    memo_table.replace_keys(edit.start, removed, inserted);
+    reach.grow(memo_table.next_key);
+    memo_table.target = updated;
+    scans.clear();
+    auto slots = static_cast<ptrdiff_t>(memo_table.capacity()) -
+        static_cast<ptrdiff_t>(capacity);
+    memo_table.account(
+        static_cast<ptrdiff_t>(reach.bytes()) -
+        static_cast<ptrdiff_t>(before) +
+        slots *
+            static_cast<ptrdiff_t>(
+                sizeof(memotable::MemoTable::value_type) + 1));
+
+    for (auto i = edit.start + inserted; i > edit.start; --i)
+    {
+        current_pos = i;
+        match_column();
+    }
+    for (auto i : affected)
+    {
+        current_pos = i + 1;
+        match_column();
+    }
+    current_pos = 0;
+    return match();
+}
+
+size_t pika::graph::ClauseTable::memory_usage() const noexcept
+{
+    return memo_table.memory_usage();
+}
+
+size_t pika::graph::ClauseTable::measure_memory() const
+{
+    auto total = memo_table.measure_memory() +
+        column.capacity() * sizeof(ParsingItem) + reach.bytes();
+    for (const auto& i : scans)
+    {
+        total += i.bytes();
+    }
+    return total;
+}
+
+/*
+ * Non-active clauses that only forward a single child, Seq and Ord of one
+ * element, are merged into the child, and non-active clauses of the same
+ * shape as an earlier one into that one. Merged clauses are neither seeded
+ * nor queued, lookups find the entries of the clause they were merged into.
+ * Active clauses and the toplevel are kept, parse trees are built from
+ * their entries.
+ */
+static std::vector<const pika::clause::Clause*> merge_clauses(
+    const pika::clause::Clause* toplevel,
+    const std::vector<const pika::clause::Clause*>& terminals,
+    const std::vector<const pika::clause::Clause*>& nodes)
+{
+    using Shape = std::tuple<
+        pika::type_utils::BaseType,
+        std::string,
+        std::vector<const pika::clause::Clause*>>;
+    std::vector<const pika::clause::Clause*> canonical;
+    auto resolve = [&](const pika::clause::Clause* clause) {
+        auto id = clause->clause_id();
+        while (id < canonical.size() && canonical[id] &&
+               canonical[id] != clause)
+        {
+            clause = canonical[id];
+            id = clause->clause_id();
+        }
+        return clause;
+    };
+    absl::flat_hash_map<Shape, const pika::clause::Clause*> shapes;
+    std::vector<const pika::clause::Clause*> children;
+    auto merge = [&](const pika::clause::Clause* clause) {
+        auto id = clause->clause_id();
+        if (id >= canonical.size())
+        {
+            canonical.resize(id + 1, nullptr);
+        }
+        canonical[id] = clause;
+        if (clause->active() || clause == toplevel)
+        {
+            return;
+        }
+        children.clear();
+        clause->sub_clauses(children);
+        for (auto& i : children)
+        {
+            i = resolve(i);
+        }
+        auto base = clause->get_base_type();
+        if ((base == pika::type_utils::BaseType::Seq ||
+             base == pika::type_utils::BaseType::Ord) &&
+            children.size() == 1 && children[0] != clause)
+        {
+            canonical[id] = children[0];
+            return;
+        }
+        /*
+         * Clauses are visited children first, so the one kept has the
+         * lowest topological order of its shape.
+         */
+        auto shape = Shape{base, std::string{clause->display()}, children};
+        auto found = shapes.try_emplace(std::move(shape), clause);
+        if (!found.second)
+        {
+            canonical[id] = found.first->second;
+        }
+    };
+    for (auto i : terminals)
+    {
+        merge(i);
+    }
+    for (auto i : nodes)
+    {
+        merge(i);
+    }
+    for (auto& i : canonical)
+    {
+        if (i)
+        {
+            i = resolve(i);
+        }
+    }
+    return canonical;
+}
+
+/*
+ * Compiles the largest regular subgrammars below the toplevel to DFAs,
+ * indexed by clause_id, and marks the clauses still matched by the engine:
+ * those reachable from the toplevel without passing through a compiled one.
+ * The toplevel itself is never compiled, its match keeps its sub-matches.
+ */
+static std::vector<std::shared_ptr<const pika::dfa::Dfa>> compile_regular(
+    const pika::clause::Clause* toplevel,
+    const std::vector<const pika::clause::Clause*>& canonical,
+    const pika::analysis::Analysis& analysis,
+    std::vector<bool>& reachable)
+{
+    std::vector<std::shared_ptr<const pika::dfa::Dfa>> compiled;
+    auto resolve = [&](const pika::clause::Clause* clause) {
+        auto id = clause->clause_id();
+        return id < canonical.size() && canonical[id] ? canonical[id] : clause;
+    };
+    auto mark = [&](const pika::clause::Clause* clause) {
+        auto id = clause->clause_id();
+        if (id >= reachable.size())
+        {
+            reachable.resize(id + 1, false);
+        }
+        if (reachable[id])
+        {
+            return false;
+        }
+        reachable[id] = true;
+        return true;
+    };
+    std::vector<const pika::clause::Clause*> stack{toplevel};
+    std::vector<const pika::clause::Clause*> children;
+    mark(toplevel);
+    while (!stack.empty())
+    {
+        auto current = stack.back();
+        stack.pop_back();
+        children.clear();
+        current->sub_clauses(children);
+        if (current != toplevel && !children.empty())
+        {
+            if (auto dfa = pika::dfa::Dfa::compile(*current, analysis))
+            {
+                auto id = current->clause_id();
+                if (id >= compiled.size())
+                {
+                    compiled.resize(id + 1);
+                }
+                compiled[id] =
+                    std::make_shared<const pika::dfa::Dfa>(std::move(*dfa));
+                continue;
+            }
+        }
+        for (auto i : children)
+        {
+            i = resolve(i);
+            if (mark(i))
+            {
+                stack.push_back(i);
+            }
+        }
+    }
+    return compiled;
 }
 
 pika::graph::ClauseTable pika::graph::construct_table(
-    const pika::clause::Clause& toplevel, std::string_view target)
+    const pika::clause::Clause& toplevel,
+    std::string_view target,
+    bool compile)
 {
     std::vector<const pika::clause::Clause*> terminals;
     std::vector<const pika::clause::Clause*> nodes;
@@ -134,22 +769,72 @@ pika::graph::ClauseTable pika::graph::construct_table(
     absl::flat_hash_set<std::type_index> visited;
     toplevel.dfs_traversal(visited, terminals, nodes);
 
+    auto canonical = merge_clauses(toplevel.get_instance(), terminals, nodes);
+    analysis::Analysis analysis(toplevel);
+    std::vector<bool> reachable;
+    std::vector<std::shared_ptr<const dfa::Dfa>> compiled;
+    if (compile)
+    {
+        compiled = compile_regular(
+            toplevel.get_instance(), canonical, analysis, reachable);
+    }
+    auto is_compiled = [&](const clause::Clause* clause) {
+        auto id = clause->clause_id();
+        return id < compiled.size() && compiled[id];
+    };
+    /*
+     * Clauses inside a compiled subgrammar are left out altogether.
+     */
+    auto kept = [&](const clause::Clause* clause) {
+        auto id = clause->clause_id();
+        return (id >= canonical.size() || canonical[id] == clause) &&
+            (id >= reachable.size() || reachable[id]);
+    };
+    std::vector<const pika::clause::Clause*> seeded;
+    for (auto i : terminals)
+    {
+        if (kept(i))
+        {
+            seeded.push_back(i);
+        }
+    }
+    /*
+     * A compiled clause behaves like a terminal: it is seeded and does not
+     * wait for its sub-clauses.
+     */
+    for (auto i : nodes)
+    {
+        if (kept(i) && is_compiled(i))
+        {
+            seeded.push_back(i);
+        }
+    }
     /*
      * The following things may always success, we need to check them everytime
      * the priority queue is empty They are behaving like a self-looping.
      */
     for (auto i : nodes)
     {
-        if (i->get_base_type() == type_utils::BaseType::Asterisks ||
-            i->get_base_type() == type_utils::BaseType::Optional ||
-            i->get_base_type() == type_utils::BaseType::NotFollowedBy)
+        if (kept(i) && !is_compiled(i) &&
+            (i->get_base_type() == type_utils::BaseType::Asterisks ||
+             i->get_base_type() == type_utils::BaseType::Optional ||
+             i->get_base_type() == type_utils::BaseType::NotFollowedBy ||
+             (i->get_base_type() == type_utils::BaseType::Repeat &&
+              static_cast<const clause::_internal::Repeat*>(i)->minimum() ==
+                  0)))
         {
             specials.push_back(i);
         }
     }
 
     ClauseTable table(
-        std::move(specials), terminals, target, toplevel.get_instance());
+        std::move(specials),
+        std::move(seeded),
+        target,
+        toplevel.get_instance());
+    table.canonical = canonical;
+    table.compiled = compiled;
+    table.scans.resize(compiled.size());
 
     /*
      * All terminals are marked with 0
@@ -169,7 +854,63 @@ pika::graph::ClauseTable pika::graph::construct_table(
 
     for (auto i : nodes)
     {
-        i->mark_seeds(table);
+        if (!is_compiled(i))
+        {
+            i->mark_seeds(table);
+        }
+    }
+
+    /*
+     * The parents of a merged clause are triggered by the clause it was
+     * merged into instead.
+     */
+    for (auto& i : table)
+    {
+        auto target = table.resolve(i.second.instance);
+        if (target != i.second.instance)
+        {
+            auto& moved = table.at(typeid(*target)).candidates;
+            moved.insert(
+                moved.end(),
+                i.second.candidates.begin(),
+                i.second.candidates.end());
+            i.second.candidates.clear();
+        }
+    }
+    for (auto& i : table)
+    {
+        auto& candidates = i.second.candidates;
+        candidates.erase(
+            std::remove_if(
+                candidates.begin(), candidates.end(), [&](auto clause) {
+                    return !kept(clause);
+                }),
+            candidates.end());
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(
+            std::unique(candidates.begin(), candidates.end()),
+            candidates.end());
+    }
+
+    /*
+     * Clauses that cannot match at a symbol are neither seeded nor queued as
+     * candidates in its columns.
+     */
+    for (auto& i : table)
+    {
+        i.second.first = analysis[*i.second.instance].first;
+    }
+    for (size_t symbol = 0; symbol < analysis::SYMBOLS; ++symbol)
+    {
+        auto& seeded = table.seeds[symbol];
+        seeded.erase(
+            std::remove_if(
+                seeded.begin(),
+                seeded.end(),
+                [&](const clause::Clause* i) {
+                    return !analysis.viable(*i, symbol);
+                }),
+            seeded.end());
     }
 
     return table;
@@ -0,0 +1,81 @@
+#include <pika/limits.hpp>
+
+static const char* describe(pika::limits::Reason reason)
+{
+    switch (reason)
+    {
+        case pika::limits::Reason::Cancelled:
+            return "parse cancelled";
+        case pika::limits::Reason::DeadlineExceeded:
+            return "parse deadline exceeded";
+        case pika::limits::Reason::MemoryExceeded:
+            return "parse memory limit exceeded";
+    }
+    return "parse aborted";
+}
+
+pika::limits::Aborted::Aborted(Reason reason)
+: std::runtime_error(describe(reason)), _reason(reason)
+{}
+
+pika::limits::Reason pika::limits::Aborted::reason() const noexcept
+{
+    return _reason;
+}
+
+void pika::limits::CancellationToken::cancel() noexcept
+{
+    cancelled.store(true, std::memory_order_relaxed);
+}
+
+bool pika::limits::CancellationToken::is_cancelled() const noexcept
+{
+    return cancelled.load(std::memory_order_relaxed);
+}
+
+void pika::limits::Limits::rearm() noexcept
+{
+    countdown = (deadline || token) ? interval : SIZE_MAX;
+}
+
+void pika::limits::Limits::set_deadline(Clock::time_point time_point) noexcept
+{
+    deadline = time_point;
+    rearm();
+}
+
+void pika::limits::Limits::set_timeout(Clock::duration duration) noexcept
+{
+    set_deadline(Clock::now() + duration);
+}
+
+void pika::limits::Limits::set_token(
+    const CancellationToken& cancellation) noexcept
+{
+    token = &cancellation;
+    rearm();
+}
+
+void pika::limits::Limits::set_interval(size_t ticks) noexcept
+{
+    interval = ticks == 0 ? 1 : ticks;
+    rearm();
+}
+
+void pika::limits::Limits::set_memory_limit(size_t bytes) noexcept
+{
+    memory_limit = bytes;
+}
+
+void pika::limits::Limits::check()
+{
+    rearm();
+    if (token && token->is_cancelled())
+    {
+        throw Aborted(Reason::Cancelled);
+    }
+    if (deadline && Clock::now() >= *deadline)
+    {
+        throw Aborted(Reason::DeadlineExceeded);
+    }
+}
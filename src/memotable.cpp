@@ -1,14 +1,19 @@
+#include <algorithm>
+#include <limits>
+#include <numeric>
 #include <pika/memotable.hpp>
+#include <stdexcept>
 
 bool pika::memotable::MemoKey::operator==(const MemoKey& that) const noexcept
 {
-    return that.start_position == start_position &&
-        that.clause_type == clause_type;
+    return that.start_position == start_position && that.clause == clause;
 }
 
 pika::memotable::MemoKey::MemoKey(
     const pika::clause::Clause* tag, size_t start_position) noexcept
-: start_position(start_position), clause_type(typeid(*tag)), tag(tag)
+: clause(static_cast<uint32_t>(tag->clause_id())),
+  start_position(static_cast<uint32_t>(start_position)),
+  tag(tag)
 {}
 
 pika::type_utils::BaseType
@@ -34,9 +39,15 @@ bool pika::memotable::Match::is_better_than(const pika::memotable::Match& that)
     {
         return false;
     }
+    return that.is_improved_by(length, sub_fst_idx);
+}
+
+bool pika::memotable::Match::is_improved_by(
+    size_t length, size_t sub_fst_idx) const noexcept
+{
     return (key.get_base_type() == pika::type_utils::BaseType::Ord &&
-            this->sub_fst_idx < that.sub_fst_idx) ||
-        this->length > that.length;
+            sub_fst_idx < this->sub_fst_idx) ||
+        length > this->length;
 }
 
 size_t pika::memotable::Match::get_length() const
@@ -44,16 +55,702 @@ size_t pika::memotable::Match::get_length() const
     return length;
 }
 
+size_t pika::memotable::Match::footprint() const noexcept
+{
+    return footprint(sub_matches.capacity());
+}
+
+size_t pika::memotable::Match::footprint(size_t capacity) noexcept
+{
+    /*
+     * allocate_shared places the match after a control block holding a
+     * vtable pointer, the two reference counts and the allocator.
+     */
+    return sizeof(Match) + sizeof(void*) + 2 * sizeof(int) +
+        sizeof(LedgerAllocator<Match>) +
+        capacity * sizeof(std::shared_ptr<Match>);
+}
+
+template<typename T>
+static size_t capacity_bytes(const std::vector<T>& vector)
+{
+    return vector.capacity() * sizeof(T);
+}
+
+static size_t row_bytes(const pika::memotable::PackratRow& row)
+{
+    return capacity_bytes(row.failed) + capacity_bytes(row.cuts) +
+        capacity_bytes(row.slots);
+}
+
 pika::memotable::MemoTable::MemoTable(std::string_view target)
 : target(target), absl::flat_hash_map<MemoKey, std::shared_ptr<Match>>()
-{}
+{
+    if (target.size() >= std::numeric_limits<uint32_t>::max())
+    {
+        throw std::length_error("input too long for memo positions");
+    }
+}
+
+pika::memotable::MemoTable::MemoTable(
+    std::string_view target, const clause::Clause& toplevel)
+: MemoTable(target)
+{
+    std::vector<const clause::Clause*> terminals;
+    std::vector<const clause::Clause*> nodes;
+    absl::flat_hash_set<std::type_index> visited;
+    toplevel.dfs_traversal(visited, terminals, nodes);
+
+    absl::flat_hash_map<std::type_index, size_t> references;
+    references[typeid(toplevel)] += 1;
+    std::vector<const clause::Clause*> children;
+    for (auto i : nodes)
+    {
+        children.clear();
+        i->sub_clauses(children);
+        for (auto j : children)
+        {
+            references[typeid(*j)] += 1;
+        }
+    }
+
+    analysis::Analysis analysis(toplevel);
+    auto mark = [&](const clause::Clause* clause, bool transient) {
+        auto id = clause->clause_id();
+        if (id >= packrat_rows.size())
+        {
+            packrat_rows.resize(id + 1);
+        }
+        packrat_rows[id].transient = transient;
+        packrat_rows[id].clause = clause;
+        packrat_rows[id].first = analysis[*clause].first;
+    };
+    for (auto i : terminals)
+    {
+        mark(i, true);
+    }
+    for (auto i : nodes)
+    {
+        mark(i, !i->memoizable() || references[typeid(*i)] <= 1);
+    }
+    account(capacity_bytes(packrat_rows));
+}
 
 char pika::memotable::MemoTable::get_char(size_t index) const
 {
     return target[index];
 }
 
+size_t
+pika::memotable::MemoTable::key_position(size_t position) const noexcept
+{
+    if (key_runs.empty())
+    {
+        return position;
+    }
+    auto run = std::upper_bound(
+        key_runs.begin(),
+        key_runs.end(),
+        position,
+        [](size_t position, const KeyRun& run) {
+            return position < run.position;
+        });
+    --run;
+    return run->key + (position - run->position);
+}
+
+size_t
+pika::memotable::MemoTable::position(const MemoKey& key) const noexcept
+{
+    for (size_t i = 0; i < key_runs.size(); ++i)
+    {
+        auto end = i + 1 < key_runs.size() ? key_runs[i + 1].position :
+                                             target.size() + 1;
+        auto& run = key_runs[i];
+        if (key.start_position >= run.key &&
+            key.start_position - run.key < end - run.position)
+        {
+            return run.position + (key.start_position - run.key);
+        }
+    }
+    return key.start_position;
+}
+
+void pika::memotable::MemoTable::replace_keys(
+    size_t start, size_t removed, size_t inserted)
+{
+    auto before = capacity_bytes(key_runs);
+    auto columns = target.size() + 1;
+    if (key_runs.empty())
+    {
+        key_runs.push_back({0, 0});
+        next_key = columns;
+    }
+    std::vector<KeyRun> runs;
+    auto push = [&](KeyRun run) {
+        if (!runs.empty() &&
+            runs.back().key + (run.position - runs.back().position) ==
+                run.key)
+        {
+            return;
+        }
+        runs.push_back(run);
+    };
+    auto resume = start + removed;
+    for (size_t i = 0; i < key_runs.size(); ++i)
+    {
+        auto run = key_runs[i];
+        auto end =
+            i + 1 < key_runs.size() ? key_runs[i + 1].position : columns;
+        if (run.position < start)
+        {
+            push(run);
+        }
+        if (run.position <= start && start < end && inserted > 0)
+        {
+            push({start, next_key});
+            next_key += inserted;
+        }
+        if (end > resume)
+        {
+            auto from = std::max(run.position, resume);
+            push({from - removed + inserted, run.key + (from - run.position)});
+        }
+    }
+    key_runs = std::move(runs);
+    account(
+        static_cast<ptrdiff_t>(capacity_bytes(key_runs)) -
+        static_cast<ptrdiff_t>(before));
+}
+
 bool pika::memotable::MemoTable::at_end(size_t index) const
 {
     return target.size() == index;
 }
+
+bool pika::memotable::MemoTable::matches(
+    size_t index, std::string_view literal) const
+{
+    return target.compare(index, literal.size(), literal) == 0;
+}
+
+std::string_view pika::memotable::MemoTable::rest(size_t index) const
+{
+    return target.substr(index);
+}
+
+static bool test_bit(const std::vector<uint64_t>& bits, size_t offset)
+{
+    return offset / 64 < bits.size() &&
+        (bits[offset / 64] >> (offset % 64) & 1);
+}
+
+static void set_bit(std::vector<uint64_t>& bits, size_t offset)
+{
+    if (offset / 64 >= bits.size())
+    {
+        bits.resize(offset / 64 + 1, 0);
+    }
+    bits[offset / 64] |= uint64_t{1} << (offset % 64);
+}
+
+bool pika::memotable::MemoTable::packrat_viable(
+    size_t clause_id, size_t index) const
+{
+    if (clause_id >= packrat_rows.size())
+    {
+        return true;
+    }
+    auto symbol = at_end(index) ? analysis::END_OF_INPUT :
+                                  static_cast<unsigned char>(get_char(index));
+    return packrat_rows[clause_id].first.test(symbol);
+}
+
+const std::shared_ptr<pika::memotable::Match>*
+pika::memotable::MemoTable::packrat_find(size_t clause_id, size_t index) const
+{
+    static const std::shared_ptr<Match> FAILURE{};
+    if (clause_id >= packrat_rows.size() || index < packrat_base)
+    {
+        return nullptr;
+    }
+    const auto& row = packrat_rows[clause_id];
+    auto offset = index - packrat_base;
+    if (offset < row.slots.size() && row.slots[offset] != 0)
+    {
+        return &packrat_matches[row.slots[offset] - 1];
+    }
+    if (test_bit(row.failed, offset))
+    {
+        return &FAILURE;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<pika::memotable::Match>
+pika::memotable::MemoTable::packrat_store(
+    size_t clause_id,
+    size_t index,
+    std::shared_ptr<Match> match,
+    bool committed)
+{
+    if (clause_id >= packrat_rows.size())
+    {
+        auto before = capacity_bytes(packrat_rows);
+        packrat_rows.resize(clause_id + 1);
+        account(capacity_bytes(packrat_rows) - before);
+    }
+    auto& row = packrat_rows[clause_id];
+    if (row.transient || index < packrat_base)
+    {
+        return match;
+    }
+    if (match && !row.clause)
+    {
+        row.clause = match->key.tag;
+    }
+    auto before = row_bytes(row) + capacity_bytes(packrat_matches);
+    auto offset = index - packrat_base;
+    counters.insertions += 1;
+    packrat_extent = std::max(packrat_extent, index + 1);
+    if (committed)
+    {
+        set_bit(row.cuts, offset);
+    }
+    if (!match)
+    {
+        set_bit(row.failed, offset);
+        account(row_bytes(row) + capacity_bytes(packrat_matches) - before);
+        return nullptr;
+    }
+    if (offset >= row.slots.size())
+    {
+        auto capacity = std::max(offset + 1, 2 * row.slots.size());
+        row.slots.resize(
+            std::min(capacity, target.size() + 1 - packrat_base), 0);
+    }
+    if (packrat_free.empty())
+    {
+        if (packrat_matches.size() >= std::numeric_limits<uint32_t>::max())
+        {
+            throw std::length_error("too many matches for packrat slots");
+        }
+        packrat_matches.push_back(match);
+        row.slots[offset] = static_cast<uint32_t>(packrat_matches.size());
+    }
+    else
+    {
+        row.slots[offset] = packrat_free.back();
+        packrat_free.pop_back();
+        packrat_matches[row.slots[offset] - 1] = match;
+    }
+    account(row_bytes(row) + capacity_bytes(packrat_matches) - before);
+    return match;
+}
+
+void pika::memotable::MemoTable::packrat_replay(size_t clause_id, size_t index)
+{
+    if (clause_id < packrat_rows.size() && index >= packrat_base &&
+        test_bit(packrat_rows[clause_id].cuts, index - packrat_base))
+    {
+        packrat_cut(index);
+    }
+}
+
+void pika::memotable::MemoTable::packrat_enter(size_t restart)
+{
+    if (packrat_choices.size() == packrat_choices.capacity())
+    {
+        auto before = capacity_bytes(packrat_choices);
+        packrat_choices.push_back({restart, 0, false});
+        account(capacity_bytes(packrat_choices) - before);
+        return;
+    }
+    packrat_choices.push_back({restart, 0, false});
+}
+
+void pika::memotable::MemoTable::packrat_restart(size_t restart)
+{
+    packrat_choices.back().restart = restart;
+    packrat_choices.back().committed = false;
+}
+
+bool pika::memotable::MemoTable::packrat_leave()
+{
+    auto committed = packrat_choices.back().committed;
+    packrat_choices.pop_back();
+    return committed;
+}
+
+size_t pika::memotable::MemoTable::packrat_operand_count() const noexcept
+{
+    return packrat_operands.size();
+}
+
+void pika::memotable::MemoTable::packrat_push_operand(
+    std::shared_ptr<Match> match)
+{
+    if (packrat_operands.size() == packrat_operands.capacity())
+    {
+        auto before = capacity_bytes(packrat_operands);
+        packrat_operands.push_back(std::move(match));
+        account(capacity_bytes(packrat_operands) - before);
+        return;
+    }
+    packrat_operands.push_back(std::move(match));
+}
+
+absl::Span<std::shared_ptr<pika::memotable::Match>>
+pika::memotable::MemoTable::packrat_top_operands(size_t base)
+{
+    return absl::MakeSpan(packrat_operands).subspan(base);
+}
+
+void pika::memotable::MemoTable::packrat_drop_operands(size_t base)
+{
+    packrat_operands.resize(base);
+}
+
+bool pika::memotable::MemoTable::packrat_committed() const
+{
+    return packrat_choices.back().committed;
+}
+
+void pika::memotable::MemoTable::packrat_cut(size_t index)
+{
+    packrat_cut_seen = true;
+    if (!packrat_choices.empty())
+    {
+        packrat_choices.back().committed = true;
+        packrat_choices.back().commits += 1;
+    }
+    auto floor = index;
+    for (const auto& i : packrat_choices)
+    {
+        if (!i.committed)
+        {
+            floor = std::min(floor, i.restart);
+        }
+    }
+    packrat_evict(floor);
+}
+
+void pika::memotable::MemoTable::packrat_evict(size_t floor)
+{
+    /*
+     * Only evict when the dead prefix outweighs the live part, so that the
+     * cost of shifting the rows is amortized over the evicted positions.
+     */
+    floor = floor / 64 * 64;
+    auto live = packrat_extent > floor ? packrat_extent - floor : 0;
+    if (floor <= packrat_base ||
+        floor - packrat_base < std::max<size_t>(64, live))
+    {
+        return;
+    }
+    auto dropped = floor - packrat_base;
+    auto free_before = capacity_bytes(packrat_free);
+    for (auto& row : packrat_rows)
+    {
+        auto words = std::min(dropped / 64, row.failed.size());
+        row.failed.erase(row.failed.begin(), row.failed.begin() + words);
+        words = std::min(dropped / 64, row.cuts.size());
+        row.cuts.erase(row.cuts.begin(), row.cuts.begin() + words);
+        auto slots = std::min(dropped, row.slots.size());
+        for (size_t i = 0; i < slots; ++i)
+        {
+            if (row.slots[i] != 0)
+            {
+                packrat_matches[row.slots[i] - 1].reset();
+                packrat_free.push_back(row.slots[i]);
+            }
+        }
+        row.slots.erase(row.slots.begin(), row.slots.begin() + slots);
+    }
+    packrat_base = floor;
+    account(
+        static_cast<ptrdiff_t>(capacity_bytes(packrat_free)) -
+        static_cast<ptrdiff_t>(free_before));
+}
+
+size_t pika::memotable::MemoTable::packrat_size() const noexcept
+{
+    return packrat_matches.size() - packrat_free.size();
+}
+
+std::shared_ptr<pika::memotable::Match> pika::memotable::MemoTable::make_match(
+    MemoKey key,
+    size_t length,
+    size_t sub_fst_idx,
+    std::vector<std::shared_ptr<Match>> sub_matches)
+{
+    auto match = std::allocate_shared<Match>(
+        LedgerAllocator<Match>(
+            ledger, Match::footprint(sub_matches.capacity())),
+        std::move(key),
+        length,
+        sub_fst_idx,
+        std::move(sub_matches));
+    limits.check_memory(ledger->usage);
+    return match;
+}
+
+std::shared_ptr<pika::memotable::Match> pika::memotable::MemoTable::make_match(
+    MemoKey key,
+    size_t length,
+    size_t sub_fst_idx,
+    absl::Span<const std::shared_ptr<Match>> sub_matches)
+{
+    return make_match(
+        std::move(key),
+        length,
+        sub_fst_idx,
+        std::vector<std::shared_ptr<Match>>(
+            sub_matches.begin(), sub_matches.end()));
+}
+
+std::shared_ptr<pika::memotable::Match> pika::memotable::MemoTable::make_match(
+    MemoKey key,
+    size_t length,
+    size_t sub_fst_idx,
+    absl::Span<std::shared_ptr<Match>> sub_matches)
+{
+    return make_match(
+        std::move(key),
+        length,
+        sub_fst_idx,
+        std::vector<std::shared_ptr<Match>>(
+            std::make_move_iterator(sub_matches.begin()),
+            std::make_move_iterator(sub_matches.end())));
+}
+
+void pika::memotable::MemoTable::account(ptrdiff_t bytes)
+{
+    ledger->usage += bytes;
+    limits.check_memory(ledger->usage);
+}
+
+size_t pika::memotable::MemoTable::memory_usage() const noexcept
+{
+    return ledger->usage;
+}
+
+/*
+ * Footprint of `match` and of the matches below it not seen yet. A match
+ * replaced in the memo is still charged while another one holds it.
+ */
+static size_t reachable_bytes(
+    const pika::memotable::Match* match,
+    absl::flat_hash_set<const pika::memotable::Match*>& seen)
+{
+    size_t total = 0;
+    std::vector<const pika::memotable::Match*> stack{match};
+    while (!stack.empty())
+    {
+        auto current = stack.back();
+        stack.pop_back();
+        if (!current || !seen.insert(current).second)
+        {
+            continue;
+        }
+        total += current->footprint();
+        for (const auto& i : current->sub_matches)
+        {
+            stack.push_back(i.get());
+        }
+    }
+    return total;
+}
+
+size_t pika::memotable::MemoTable::measure_memory() const
+{
+    absl::flat_hash_set<const Match*> seen;
+    size_t total = capacity() * (sizeof(value_type) + 1);
+    for (const auto& i : *this)
+    {
+        total += reachable_bytes(i.second.get(), seen);
+    }
+    total += capacity_bytes(packrat_rows);
+    for (const auto& i : packrat_rows)
+    {
+        total += row_bytes(i);
+    }
+    total += capacity_bytes(packrat_matches);
+    for (const auto& i : packrat_matches)
+    {
+        total += reachable_bytes(i.get(), seen);
+    }
+    for (const auto& i : packrat_operands)
+    {
+        total += reachable_bytes(i.get(), seen);
+    }
+    total += capacity_bytes(packrat_free);
+    total += capacity_bytes(packrat_choices);
+    total += capacity_bytes(packrat_operands);
+    total += capacity_bytes(key_runs);
+    return total;
+}
+
+double pika::memotable::ClauseOccupancy::average_sub_matches() const noexcept
+{
+    return entries ? static_cast<double>(sub_matches) / entries : 0;
+}
+
+/*
+ * Number of positions inside at least one of the half-open spans.
+ */
+static size_t covered_positions(std::vector<std::pair<size_t, size_t>>& spans)
+{
+    std::sort(spans.begin(), spans.end());
+    size_t covered = 0, reached = 0;
+    for (auto [start, end] : spans)
+    {
+        start = std::max(start, reached);
+        if (end > start)
+        {
+            covered += end - start;
+            reached = end;
+        }
+    }
+    return covered;
+}
+
+pika::memotable::Occupancy
+pika::memotable::MemoTable::occupancy(bool histogram) const
+{
+    Occupancy result;
+    std::vector<ClauseOccupancy> clauses;
+    std::vector<std::vector<std::pair<size_t, size_t>>> spans;
+    if (histogram)
+    {
+        result.histogram.assign(target.size() + 1, 0);
+    }
+    auto entry = [&](size_t id) -> ClauseOccupancy& {
+        if (id >= clauses.size())
+        {
+            clauses.resize(id + 1);
+            spans.resize(id + 1);
+        }
+        return clauses[id];
+    };
+    auto add = [&](size_t id, const Match& match, size_t bytes) {
+        auto& occupancy = entry(id);
+        auto start = position(match.key);
+        occupancy.clause = match.key.tag;
+        occupancy.entries += 1;
+        occupancy.bytes += bytes;
+        occupancy.sub_matches += match.sub_matches.size();
+        spans[id].emplace_back(start, start + match.length);
+        if (histogram && start < result.histogram.size())
+        {
+            result.histogram[start] += 1;
+        }
+    };
+    for (const auto& i : *this)
+    {
+        add(i.first.tag->clause_id(),
+            *i.second,
+            i.second->footprint() + sizeof(value_type) + 1);
+    }
+    for (size_t id = 0; id < packrat_rows.size(); ++id)
+    {
+        const auto& row = packrat_rows[id];
+        size_t failures = 0;
+        for (auto bits : row.failed)
+        {
+            failures += __builtin_popcountll(bits);
+        }
+        auto slots = std::count_if(
+            row.slots.begin(), row.slots.end(), [](uint32_t slot) {
+                return slot != 0;
+            });
+        if (failures == 0 && slots == 0)
+        {
+            continue;
+        }
+        for (auto slot : row.slots)
+        {
+            if (slot != 0)
+            {
+                const auto& match = *packrat_matches[slot - 1];
+                add(id,
+                    match,
+                    match.footprint() + sizeof(std::shared_ptr<Match>));
+            }
+        }
+        auto& occupancy = entry(id);
+        if (!occupancy.clause)
+        {
+            occupancy.clause = row.clause;
+        }
+        occupancy.failures += failures;
+        occupancy.bytes += row_bytes(row);
+    }
+    for (size_t id = 0; id < clauses.size(); ++id)
+    {
+        auto& occupancy = clauses[id];
+        if (occupancy.entries == 0 && occupancy.failures == 0)
+        {
+            continue;
+        }
+        occupancy.covered = covered_positions(spans[id]);
+        result.entries += occupancy.entries;
+        result.failures += occupancy.failures;
+        result.bytes += occupancy.bytes;
+        result.clauses.push_back(occupancy);
+    }
+    std::stable_sort(
+        result.clauses.begin(),
+        result.clauses.end(),
+        [](const ClauseOccupancy& a, const ClauseOccupancy& b) {
+            return a.bytes > b.bytes;
+        });
+    return result;
+}
+
+void pika::memotable::Occupancy::dump(std::ostream& output, size_t rows) const
+{
+    output << "entries=" << entries << ", failures=" << failures
+           << ", bytes=" << bytes << std::endl;
+    for (const auto& i : clauses)
+    {
+        if (!i.clause)
+        {
+            output << "<unknown>";
+        }
+        else if (i.clause->label())
+        {
+            output << i.clause->label().value() << " <- "
+                   << i.clause->display();
+        }
+        else
+        {
+            output << i.clause->display();
+        }
+        output << ": entries=" << i.entries << ", failures=" << i.failures
+               << ", bytes=" << i.bytes
+               << ", sub_matches=" << i.average_sub_matches()
+               << ", covered=" << i.covered << std::endl;
+    }
+    if (histogram.empty() || rows == 0)
+    {
+        return;
+    }
+    auto width = (histogram.size() + rows - 1) / rows;
+    std::vector<size_t> folded;
+    for (size_t i = 0; i < histogram.size(); i += width)
+    {
+        auto end = std::min(histogram.size(), i + width);
+        folded.push_back(std::accumulate(
+            histogram.begin() + i, histogram.begin() + end, size_t{0}));
+    }
+    auto peak = std::max<size_t>(
+        1, *std::max_element(folded.begin(), folded.end()));
+    for (size_t i = 0; i < folded.size(); ++i)
+    {
+        auto start = i * width;
+        auto end = std::min(histogram.size(), start + width);
+        output << "[" << start << ", " << end << "): " << folded[i] << " "
+               << std::string(folded[i] * 40 / peak, '#') << std::endl;
+    }
+}
@@ -2,12 +2,43 @@
 // Created by schrodinger on 10/21/20.
 //
 #include <pika/parse_tree.hpp>
+#include <stdexcept>
 
-std::vector<std::unique_ptr<const pika::parse_tree::TreeNode>> reduced(
+/*
+ * A match stored with only its length, see Match::UNEXPANDED, is handed back
+ * to its clause to recover the sub-matches. Other matches are returned as
+ * they are.
+ */
+static std::shared_ptr<const pika::memotable::Match> expand(
+    const pika::memotable::Match& match,
+    size_t position,
+    const pika::memotable::MemoTable& table,
+    std::optional<pika::memotable::MemoTable>& scratch)
+{
+    if (match.sub_fst_idx != pika::memotable::Match::UNEXPANDED)
+    {
+        return {std::shared_ptr<const pika::memotable::Match>{}, &match};
+    }
+    if (!scratch)
+    {
+        scratch.emplace(table.rest(0));
+    }
+    auto result = match.key.tag->expand(match, position, *scratch);
+    if (!result || result->length != match.length)
+    {
+        throw std::logic_error("unexpanded match not recovered by its clause");
+    }
+    return result;
+}
+
+std::vector<std::unique_ptr<const pika::parse_tree::TreeNode>>
+pika::parse_tree::TreeNode::reduced(
     std::type_index parent,
     pika::type_utils::BaseType base,
     const std::vector<std::shared_ptr<pika::memotable::Match>>& sub_matches,
-    const pika::memotable::MemoTable& table)
+    size_t position,
+    const pika::memotable::MemoTable& table,
+    Scratch& scratch)
 {
     std::vector<std::unique_ptr<const pika::parse_tree::TreeNode>> result;
     if (base != pika::type_utils::BaseType::Plus &&
@@ -15,10 +46,10 @@ std::vector<std::unique_ptr<const pika::parse_tree::TreeNode>> reduced(
     {
         for (const auto& i : sub_matches)
         {
-            auto current =
-                pika::parse_tree::TreeNode::build_from_match(*i, table);
+            auto current = build_from_match(*i, position, table, scratch);
             std::move(
                 current.begin(), current.end(), std::back_inserter(result));
+            position += i->length;
         }
     }
     else if (!sub_matches.empty())
@@ -36,10 +67,10 @@ std::vector<std::unique_ptr<const pika::parse_tree::TreeNode>> reduced(
         }
         for (const auto& i : real)
         {
-            auto current =
-                pika::parse_tree::TreeNode::build_from_match(*i, table);
+            auto current = build_from_match(*i, position, table, scratch);
             std::move(
                 current.begin(), current.end(), std::back_inserter(result));
+            position += i->length;
         }
     }
     return result;
@@ -50,11 +81,22 @@ pika::parse_tree::TreeNode::build_from_match(
     const pika::memotable::Match& match,
     const pika::memotable::MemoTable& table)
 {
+    Scratch scratch;
+    return build_from_match(match, table.position(match.key), table, scratch);
+}
+
+std::vector<std::unique_ptr<const pika::parse_tree::TreeNode>>
+pika::parse_tree::TreeNode::build_from_match(
+    const pika::memotable::Match& match,
+    size_t position,
+    const pika::memotable::MemoTable& table,
+    Scratch& scratch)
+{
+    auto expanded = expand(match, position, table, scratch);
     if (match.key.tag->active())
     {
         std::vector<std::unique_ptr<const pika::parse_tree::TreeNode>> result;
-        result.emplace_back(
-            std::make_unique<const pika::parse_tree::TreeNode>(match, table));
+        result.emplace_back(new TreeNode(expanded, position, table, scratch));
         return result;
     }
     else
@@ -62,8 +104,10 @@ pika::parse_tree::TreeNode::build_from_match(
         return reduced(
             typeid(*match.key.tag),
             match.key.get_base_type(),
-            match.sub_matches,
-            table);
+            expanded->sub_matches,
+            position,
+            table,
+            scratch);
     }
 }
 
@@ -87,14 +131,32 @@ pika::parse_tree::TreeNode::end() const noexcept
 pika::parse_tree::TreeNode::TreeNode(
     const pika::memotable::Match& match,
     const pika::memotable::MemoTable& table)
-: matched_clause(match.key.tag),
-  matched_content(table.target.substr(
-      match.key.start_position, match.key.start_position + match.length)),
-  branches(reduced(
-      typeid(*match.key.tag),
-      match.key.get_base_type(),
-      match.sub_matches,
-      table))
+: TreeNode(match, table.position(match.key), table, Scratch{})
+{}
+
+pika::parse_tree::TreeNode::TreeNode(
+    const pika::memotable::Match& match,
+    size_t position,
+    const pika::memotable::MemoTable& table,
+    Scratch&& scratch)
+: TreeNode(expand(match, position, table, scratch), position, table, scratch)
+{}
+
+pika::parse_tree::TreeNode::TreeNode(
+    const std::shared_ptr<const pika::memotable::Match>& match,
+    size_t position,
+    const pika::memotable::MemoTable& table,
+    Scratch& scratch)
+: branches(reduced(
+      typeid(*match->key.tag),
+      match->key.get_base_type(),
+      match->sub_matches,
+      position,
+      table,
+      scratch)),
+  matched_clause(match->key.tag),
+  matched_content(table.target.substr(position, match->length)),
+  alternative(match->sub_fst_idx)
 {}
 
 size_t pika::parse_tree::TreeNode::size() const noexcept
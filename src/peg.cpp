@@ -0,0 +1,1042 @@
+#include <algorithm>
+#include <pika/clause.hpp>
+#include <pika/clause.ipp>
+#include <pika/memotable.hpp>
+#include <pika/parse_tree.hpp>
+#include <pika/peg.hpp>
+#include <stdexcept>
+#include <utility>
+
+/*
+ * The grammar of grammars, matched by the packrat engine. Only the nodes
+ * the loader reads are active.
+ */
+namespace
+{
+    struct PegExpression;
+
+    PIKA_DECLARE(
+        PegComment,
+        PIKA_SEQ(
+            PIKA_CHAR('#'),
+            PIKA_ASTERISKS(
+                PIKA_SEQ(PIKA_NOT_FOLLOWED_BY(PIKA_CHAR('\n')), PIKA_ANY))),
+        false);
+    PIKA_DECLARE(
+        PegSpacing,
+        PIKA_ASTERISKS(PIKA_ORD(PIKA_CHAR_SET(" \t\r\n"), PegComment)),
+        false);
+    PIKA_DECLARE(
+        PegIdentifier,
+        PIKA_SEQ(
+            PIKA_CHAR_SET("a-zA-Z_"),
+            PIKA_ASTERISKS(PIKA_CHAR_SET("a-zA-Z_0-9"))),
+        true);
+    PIKA_DECLARE(PegName, PIKA_SEQ(PegIdentifier, PegSpacing), false);
+    PIKA_DECLARE(
+        PegArrow, PIKA_SEQ(PIKA_CHAR('<'), PIKA_CHAR('-'), PegSpacing), false);
+    PIKA_DECLARE(PegHex, PIKA_CHAR_SET("0-9a-fA-F"), false);
+    PIKA_DECLARE(
+        PegChar,
+        PIKA_ORD(
+            PIKA_SEQ(PIKA_CHAR('\\'), PIKA_CHAR('x'), PegHex, PegHex),
+            PIKA_SEQ(PIKA_CHAR('\\'), PIKA_ANY),
+            PIKA_ANY),
+        true);
+    PIKA_DECLARE(
+        PegLiteral,
+        PIKA_ORD(
+            PIKA_SEQ(
+                PIKA_CHAR('\''),
+                PIKA_ASTERISKS(
+                    PIKA_SEQ(PIKA_NOT_FOLLOWED_BY(PIKA_CHAR('\'')), PegChar)),
+                PIKA_CHAR('\'')),
+            PIKA_SEQ(
+                PIKA_CHAR('"'),
+                PIKA_ASTERISKS(
+                    PIKA_SEQ(PIKA_NOT_FOLLOWED_BY(PIKA_CHAR('"')), PegChar)),
+                PIKA_CHAR('"'))),
+        true);
+    PIKA_DECLARE(PegNegate, PIKA_CHAR('^'), true);
+    PIKA_DECLARE(
+        PegRange,
+        PIKA_SEQ(
+            PegChar,
+            PIKA_OPTIONAL(PIKA_SEQ(
+                PIKA_CHAR('-'),
+                PIKA_NOT_FOLLOWED_BY(PIKA_CHAR(']')),
+                PegChar))),
+        true);
+    PIKA_DECLARE(
+        PegClass,
+        PIKA_SEQ(
+            PIKA_CHAR('['),
+            PIKA_OPTIONAL(PegNegate),
+            PIKA_ASTERISKS(
+                PIKA_SEQ(PIKA_NOT_FOLLOWED_BY(PIKA_CHAR(']')), PegRange)),
+            PIKA_CHAR(']')),
+        true);
+    PIKA_DECLARE(PegDot, PIKA_CHAR('.'), true);
+    PIKA_DECLARE(
+        PegPrimary,
+        PIKA_ORD(
+            PIKA_SEQ(PegName, PIKA_NOT_FOLLOWED_BY(PegArrow)),
+            PIKA_SEQ(
+                PIKA_CHAR('('),
+                PegSpacing,
+                PegExpression,
+                PIKA_CHAR(')'),
+                PegSpacing),
+            PIKA_SEQ(PegLiteral, PegSpacing),
+            PIKA_SEQ(PegClass, PegSpacing),
+            PIKA_SEQ(PegDot, PegSpacing)),
+        false);
+    PIKA_DECLARE(PegRepetition, PIKA_CHAR_SET("?*+"), true);
+    PIKA_DECLARE(
+        PegSuffix,
+        PIKA_SEQ(
+            PegPrimary, PIKA_OPTIONAL(PIKA_SEQ(PegRepetition, PegSpacing))),
+        true);
+    PIKA_DECLARE(PegLookahead, PIKA_CHAR_SET("&!"), true);
+    PIKA_DECLARE(
+        PegPrefix,
+        PIKA_SEQ(PIKA_OPTIONAL(PIKA_SEQ(PegLookahead, PegSpacing)), PegSuffix),
+        true);
+    PIKA_DECLARE(PegSequence, PIKA_ASTERISKS(PegPrefix), true);
+    PIKA_DECLARE(
+        PegExpression,
+        PIKA_SEQ(
+            PegSequence,
+            PIKA_ASTERISKS(PIKA_SEQ(PIKA_CHAR('/'), PegSpacing, PegSequence))),
+        true);
+    PIKA_DECLARE(PegHidden, PIKA_CHAR('~'), true);
+    PIKA_DECLARE(
+        PegDefinition,
+        PIKA_SEQ(
+            PIKA_OPTIONAL(PIKA_SEQ(PegHidden, PegSpacing)),
+            PegName,
+            PegArrow,
+            PegExpression),
+        true);
+    PIKA_DECLARE(
+        PegGrammar,
+        PIKA_SEQ(
+            PegSpacing,
+            PIKA_PLUS(PegDefinition),
+            PIKA_NOT_FOLLOWED_BY(PIKA_ANY)),
+        true);
+
+    using pika::parse_tree::TreeNode;
+
+    /*
+     * A built clause, or a rule referred to by name that is resolved once
+     * all rules are known.
+     */
+    struct Operand
+    {
+        uint32_t instruction;
+        std::string_view reference;
+    };
+
+    /*
+     * Emits the instructions of the expressions of a parsed grammar,
+     * sub-clauses before their parents.
+     */
+    struct Builder
+    {
+        pika::peg::Grammar& grammar;
+        std::vector<std::pair<size_t, std::string_view>> references;
+
+        uint32_t emit(pika::peg::Op op, size_t first, size_t count);
+
+        Operand
+        composite(pika::peg::Op op, const std::vector<Operand>& operands);
+
+        Operand set(const std::array<uint64_t, 4>& members);
+
+        Operand expression(const TreeNode& node);
+
+        Operand sequence(const TreeNode& node);
+
+        Operand prefix(const TreeNode& node);
+
+        Operand suffix(const TreeNode& node);
+
+        Operand literal(const TreeNode& node);
+
+        Operand char_class(const TreeNode& node);
+    };
+}
+
+static unsigned char decode(const TreeNode& node)
+{
+    auto content = node.matched_content;
+    switch (node.alternative)
+    {
+        case 0:
+            return static_cast<unsigned char>(
+                std::stoi(std::string{content.substr(2)}, nullptr, 16));
+        case 1:
+            switch (content[1])
+            {
+                case 'n':
+                    return '\n';
+                case 'r':
+                    return '\r';
+                case 't':
+                    return '\t';
+                case '0':
+                    return '\0';
+                default:
+                    return content[1];
+            }
+        default:
+            return content[0];
+    }
+}
+
+static void insert(std::array<uint64_t, 4>& members, unsigned char byte)
+{
+    members[byte / 64] |= uint64_t{1} << (byte % 64);
+}
+
+uint32_t Builder::emit(pika::peg::Op op, size_t first, size_t count)
+{
+    grammar.instructions.push_back(
+        {op,
+         pika::peg::Grammar::NO_RULE,
+         static_cast<uint32_t>(first),
+         static_cast<uint32_t>(count)});
+    return static_cast<uint32_t>(grammar.instructions.size() - 1);
+}
+
+Operand
+Builder::composite(pika::peg::Op op, const std::vector<Operand>& operands)
+{
+    auto first = grammar.children.size();
+    for (auto& i : operands)
+    {
+        if (!i.reference.empty())
+        {
+            references.emplace_back(grammar.children.size(), i.reference);
+        }
+        grammar.children.push_back(i.instruction);
+    }
+    return {emit(op, first, operands.size()), {}};
+}
+
+Operand Builder::set(const std::array<uint64_t, 4>& members)
+{
+    grammar.sets.push_back(members);
+    return {emit(pika::peg::Op::Set, grammar.sets.size() - 1, 1), {}};
+}
+
+Operand Builder::expression(const TreeNode& node)
+{
+    std::vector<Operand> alternatives;
+    for (auto& i : node)
+    {
+        alternatives.push_back(sequence(*i));
+    }
+    if (alternatives.size() == 1)
+    {
+        return alternatives[0];
+    }
+    return composite(pika::peg::Op::Ord, alternatives);
+}
+
+Operand Builder::sequence(const TreeNode& node)
+{
+    std::vector<Operand> elements;
+    for (auto& i : node)
+    {
+        elements.push_back(prefix(*i));
+    }
+    if (elements.empty())
+    {
+        return {emit(pika::peg::Op::String, grammar.literals.size(), 0), {}};
+    }
+    if (elements.size() == 1)
+    {
+        return elements[0];
+    }
+    return composite(pika::peg::Op::Seq, elements);
+}
+
+Operand Builder::prefix(const TreeNode& node)
+{
+    if (node.size() == 1)
+    {
+        return suffix(**node.begin());
+    }
+    auto op = (*node.begin())->matched_content[0] == '&' ?
+        pika::peg::Op::FollowedBy :
+        pika::peg::Op::NotFollowedBy;
+    return composite(op, {suffix(**(node.begin() + 1))});
+}
+
+Operand Builder::suffix(const TreeNode& node)
+{
+    auto& primary = **node.begin();
+    Operand result{};
+    if (primary.is_clause<PegIdentifier>())
+    {
+        result.reference = primary.matched_content;
+    }
+    else if (primary.is_clause<PegExpression>())
+    {
+        result = expression(primary);
+    }
+    else if (primary.is_clause<PegLiteral>())
+    {
+        result = literal(primary);
+    }
+    else if (primary.is_clause<PegClass>())
+    {
+        result = char_class(primary);
+    }
+    else
+    {
+        result = set({~uint64_t{0}, ~uint64_t{0}, ~uint64_t{0}, ~uint64_t{0}});
+    }
+    if (node.size() == 1)
+    {
+        return result;
+    }
+    switch ((*(node.begin() + 1))->matched_content[0])
+    {
+        case '?':
+            return composite(pika::peg::Op::Optional, {result});
+        case '*':
+            return composite(pika::peg::Op::Asterisks, {result});
+        default:
+            return composite(pika::peg::Op::Plus, {result});
+    }
+}
+
+/*
+ * Literals of a single byte are matched as sets.
+ */
+Operand Builder::literal(const TreeNode& node)
+{
+    std::string bytes;
+    for (auto& i : node)
+    {
+        bytes.push_back(static_cast<char>(decode(*i)));
+    }
+    if (bytes.size() == 1)
+    {
+        std::array<uint64_t, 4> members{};
+        insert(members, bytes[0]);
+        return set(members);
+    }
+    auto first = grammar.literals.size();
+    grammar.literals += bytes;
+    return {emit(pika::peg::Op::String, first, bytes.size()), {}};
+}
+
+Operand Builder::char_class(const TreeNode& node)
+{
+    std::array<uint64_t, 4> members{};
+    bool negated = false;
+    for (auto& i : node)
+    {
+        if (i->is_clause<PegNegate>())
+        {
+            negated = true;
+            continue;
+        }
+        unsigned start = decode(**i->begin());
+        unsigned end = i->size() == 2 ? decode(**(i->begin() + 1)) : start;
+        for (auto c = start; c <= end; ++c)
+        {
+            insert(members, static_cast<unsigned char>(c));
+        }
+    }
+    if (negated)
+    {
+        for (auto& i : members)
+        {
+            i = ~i;
+        }
+    }
+    return set(members);
+}
+
+/*
+ * Fills in the tables of the pika interpreter, see Grammar.
+ */
+static void prepare(pika::peg::Grammar& grammar)
+{
+    using pika::peg::Op;
+    auto size = grammar.instructions.size();
+    std::vector<bool> visited(size);
+    grammar.order.assign(size, 0);
+    uint32_t next = 0;
+    auto visit = [&](auto& self, uint32_t instruction) -> void {
+        if (visited[instruction])
+        {
+            return;
+        }
+        visited[instruction] = true;
+        auto& current = grammar.instructions[instruction];
+        if (current.op != Op::Set && current.op != Op::String)
+        {
+            for (uint32_t i = 0; i < current.count; ++i)
+            {
+                self(self, grammar.children[current.first + i]);
+            }
+        }
+        grammar.order[instruction] = next++;
+    };
+    for (auto& i : grammar.rules)
+    {
+        visit(visit, i.body);
+    }
+
+    /*
+     * A sequence is only started by its first element, like Seq::mark_seeds.
+     */
+    std::vector<std::vector<uint32_t>> parents(size);
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        auto& current = grammar.instructions[i];
+        if (current.op == Op::Set || current.op == Op::String)
+        {
+            continue;
+        }
+        auto count = current.op == Op::Seq ? 1 : current.count;
+        for (uint32_t j = 0; j < count; ++j)
+        {
+            parents[grammar.children[current.first + j]].push_back(i);
+        }
+    }
+    grammar.parents_start.clear();
+    grammar.parents.clear();
+    for (auto& i : parents)
+    {
+        grammar.parents_start.push_back(
+            static_cast<uint32_t>(grammar.parents.size()));
+        grammar.parents.insert(grammar.parents.end(), i.begin(), i.end());
+    }
+    grammar.parents_start.push_back(
+        static_cast<uint32_t>(grammar.parents.size()));
+
+    grammar.seeds.assign(257, {});
+    for (size_t symbol = 0; symbol <= 256; ++symbol)
+    {
+        for (uint32_t i = 0; i < size; ++i)
+        {
+            auto& current = grammar.instructions[i];
+            bool seeded = false;
+            switch (current.op)
+            {
+                case Op::Set:
+                    seeded = symbol < 256 &&
+                        grammar.contains(
+                            current.first, static_cast<char>(symbol));
+                    break;
+                case Op::String:
+                    seeded = current.count == 0 ||
+                        (symbol < 256 &&
+                         static_cast<unsigned char>(
+                             grammar.literals[current.first]) == symbol);
+                    break;
+                case Op::Asterisks:
+                case Op::Optional:
+                case Op::NotFollowedBy:
+                    seeded = true;
+                    break;
+                default:
+                    break;
+            }
+            if (seeded)
+            {
+                grammar.seeds[symbol].push_back(i);
+            }
+        }
+    }
+}
+
+std::optional<pika::peg::Grammar>
+pika::peg::Grammar::load(std::string_view text)
+{
+    memotable::MemoTable table(text);
+    auto match = PegGrammar().packrat_match(table, 0);
+    if (!match)
+    {
+        return std::nullopt;
+    }
+    TreeNode tree(*match, table);
+    Grammar result;
+    Builder builder{result, {}};
+    absl::flat_hash_map<std::string_view, uint32_t> names;
+    for (auto& i : tree)
+    {
+        auto current = i->begin();
+        bool active = true;
+        if ((*current)->is_clause<PegHidden>())
+        {
+            active = false;
+            ++current;
+        }
+        auto name = (*current)->matched_content;
+        auto body = builder.expression(**(current + 1));
+        if (!body.reference.empty())
+        {
+            body = builder.composite(Op::Seq, {body});
+        }
+        auto rule = static_cast<uint32_t>(result.rules.size());
+        if (!names.try_emplace(name, rule).second)
+        {
+            return std::nullopt;
+        }
+        result.instructions[body.instruction].rule = rule;
+        result.rules.push_back({std::string{name}, body.instruction, active});
+    }
+    for (auto& i : builder.references)
+    {
+        auto found = names.find(i.second);
+        if (found == names.end())
+        {
+            return std::nullopt;
+        }
+        result.children[i.first] = result.rules[found->second].body;
+    }
+    prepare(result);
+    return result;
+}
+
+std::optional<uint32_t>
+pika::peg::Grammar::find(std::string_view name) const
+{
+    for (uint32_t i = 0; i < rules.size(); ++i)
+    {
+        if (rules[i].name == name)
+        {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+bool pika::peg::Grammar::contains(uint32_t set, char c) const noexcept
+{
+    auto byte = static_cast<unsigned char>(c);
+    return sets[set][byte / 64] >> (byte % 64) & 1;
+}
+
+pika::peg::Packrat::Packrat(const Grammar& grammar, std::string_view input)
+: grammar(grammar), input(input)
+{
+    if (input.size() > UINT32_MAX - 2)
+    {
+        throw std::length_error("input too long for the packrat memo");
+    }
+}
+
+size_t pika::peg::Packrat::evaluate(uint32_t instruction, size_t index)
+{
+    auto& current = grammar.instructions[instruction];
+    auto memoized = current.rule != Grammar::NO_RULE;
+    auto key = index * grammar.rules.size() + current.rule;
+    if (memoized)
+    {
+        /*
+         * Fails a left recursive visit.
+         */
+        auto found = memo.try_emplace(key, 1);
+        if (!found.second)
+        {
+            auto known = found.first->second;
+            return known == 1 ? NO_MATCH : known - 2;
+        }
+    }
+    auto children = grammar.children.data() + current.first;
+    size_t length = NO_MATCH;
+    switch (current.op)
+    {
+        case Op::Seq:
+            length = 0;
+            for (uint32_t i = 0; i < current.count; ++i)
+            {
+                auto sub = evaluate(children[i], index + length);
+                if (sub == NO_MATCH)
+                {
+                    length = NO_MATCH;
+                    break;
+                }
+                length += sub;
+            }
+            break;
+        case Op::Ord:
+            for (uint32_t i = 0; i < current.count; ++i)
+            {
+                length = evaluate(children[i], index);
+                if (length != NO_MATCH)
+                {
+                    break;
+                }
+            }
+            break;
+        case Op::Asterisks:
+        case Op::Plus:
+        {
+            size_t count = 0;
+            length = 0;
+            for (;;)
+            {
+                auto sub = evaluate(children[0], index + length);
+                if (sub == NO_MATCH)
+                {
+                    break;
+                }
+                count += 1;
+                length += sub;
+                if (sub == 0)
+                {
+                    break;
+                }
+            }
+            if (count == 0 && current.op == Op::Plus)
+            {
+                length = NO_MATCH;
+            }
+            break;
+        }
+        case Op::Optional:
+        {
+            auto sub = evaluate(children[0], index);
+            length = sub == NO_MATCH ? 0 : sub;
+            break;
+        }
+        case Op::FollowedBy:
+            length = evaluate(children[0], index) != NO_MATCH ? 0 : NO_MATCH;
+            break;
+        case Op::NotFollowedBy:
+            length = evaluate(children[0], index) == NO_MATCH ? 0 : NO_MATCH;
+            break;
+        case Op::Set:
+            if (index < input.size() &&
+                grammar.contains(current.first, input[index]))
+            {
+                length = 1;
+            }
+            break;
+        case Op::String:
+            if (input.substr(index, current.count) ==
+                std::string_view{grammar.literals}.substr(
+                    current.first, current.count))
+            {
+                length = current.count;
+            }
+            break;
+    }
+    if (memoized)
+    {
+        memo[key] = length == NO_MATCH ? 1 : static_cast<uint32_t>(length + 2);
+    }
+    return length;
+}
+
+size_t pika::peg::Packrat::match(uint32_t rule, size_t index)
+{
+    return evaluate(grammar.rules[rule].body, index);
+}
+
+
+/*
+ * While the body of a rule is replayed, the rule fails at the same position
+ * like it did while the body was evaluated.
+ */
+void pika::peg::Packrat::collect(
+    uint32_t instruction,
+    size_t index,
+    size_t matched,
+    std::vector<Node>& output)
+{
+    auto& current = grammar.instructions[instruction];
+    auto* into = &output;
+    auto memoized = current.rule != Grammar::NO_RULE;
+    auto key = index * grammar.rules.size() + current.rule;
+    uint32_t saved = 0;
+    if (memoized)
+    {
+        if (grammar.rules[current.rule].active)
+        {
+            output.push_back({current.rule, index, matched, {}});
+            into = &output.back().children;
+        }
+        saved = std::exchange(memo[key], 1);
+    }
+    auto children = grammar.children.data() + current.first;
+    switch (current.op)
+    {
+        case Op::Seq:
+        {
+            size_t offset = 0;
+            for (uint32_t i = 0; i < current.count; ++i)
+            {
+                auto sub = evaluate(children[i], index + offset);
+                collect(children[i], index + offset, sub, *into);
+                offset += sub;
+            }
+            break;
+        }
+        case Op::Ord:
+            for (uint32_t i = 0; i < current.count; ++i)
+            {
+                auto sub = evaluate(children[i], index);
+                if (sub != NO_MATCH)
+                {
+                    collect(children[i], index, sub, *into);
+                    break;
+                }
+            }
+            break;
+        case Op::Asterisks:
+        case Op::Plus:
+        {
+            size_t offset = 0;
+            for (;;)
+            {
+                auto sub = evaluate(children[0], index + offset);
+                if (sub == NO_MATCH)
+                {
+                    break;
+                }
+                collect(children[0], index + offset, sub, *into);
+                offset += sub;
+                if (sub == 0)
+                {
+                    break;
+                }
+            }
+            break;
+        }
+        case Op::Optional:
+        {
+            auto sub = evaluate(children[0], index);
+            if (sub != NO_MATCH)
+            {
+                collect(children[0], index, sub, *into);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    if (memoized)
+    {
+        memo[key] = saved;
+    }
+}
+
+std::optional<pika::peg::Node>
+pika::peg::Packrat::parse(uint32_t rule, size_t index)
+{
+    auto matched = match(rule, index);
+    if (matched == NO_MATCH)
+    {
+        return std::nullopt;
+    }
+    std::vector<Node> nodes;
+    collect(grammar.rules[rule].body, index, matched, nodes);
+    if (grammar.rules[rule].active)
+    {
+        return std::move(nodes[0]);
+    }
+    return Node{rule, index, matched, std::move(nodes)};
+}
+
+size_t pika::peg::Packrat::entries() const noexcept
+{
+    return memo.size();
+}
+
+pika::peg::PikaTable::PikaTable(const Grammar& grammar, std::string_view input)
+: grammar(grammar), input(input), position(input.size())
+{}
+
+uint32_t pika::peg::PikaTable::find(uint32_t instruction, size_t index) const
+{
+    auto found = memo.find(index * grammar.instructions.size() + instruction);
+    return found == memo.end() ? NONE : found->second;
+}
+
+void pika::peg::PikaTable::add(
+    uint32_t instruction, size_t length, uint32_t alternative)
+{
+    auto found = memo.try_emplace(
+        position * grammar.instructions.size() + instruction,
+        static_cast<uint32_t>(matches.size()));
+    if (!found.second)
+    {
+        auto& known = matches[found.first->second];
+        bool preferred = grammar.instructions[instruction].op == Op::Ord &&
+            alternative < known.alternative;
+        if (!preferred && length <= known.length)
+        {
+            return;
+        }
+        found.first->second = static_cast<uint32_t>(matches.size());
+        replaced += 1;
+    }
+    if (matches.size() == NONE)
+    {
+        throw std::length_error("too many matches for the pika table");
+    }
+    matches.push_back(
+        {instruction,
+         alternative,
+         length,
+         static_cast<uint32_t>(submatches.size()),
+         static_cast<uint32_t>(pending.size())});
+    submatches.insert(submatches.end(), pending.begin(), pending.end());
+    auto end = grammar.parents_start[instruction + 1];
+    for (auto i = grammar.parents_start[instruction]; i < end; ++i)
+    {
+        auto parent = grammar.parents[i];
+        queue.emplace(grammar.order[parent], parent);
+    }
+}
+
+void pika::peg::PikaTable::evaluate(uint32_t instruction)
+{
+    auto& current = grammar.instructions[instruction];
+    auto children = grammar.children.data() + current.first;
+    pending.clear();
+    switch (current.op)
+    {
+        case Op::Seq:
+        {
+            size_t length = 0;
+            for (uint32_t i = 0; i < current.count; ++i)
+            {
+                auto sub = find(children[i], position + length);
+                if (sub == NONE)
+                {
+                    return;
+                }
+                pending.push_back(sub);
+                length += matches[sub].length;
+            }
+            add(instruction, length, 0);
+            break;
+        }
+        case Op::Ord:
+            for (uint32_t i = 0; i < current.count; ++i)
+            {
+                auto sub = find(children[i], position);
+                if (sub != NONE)
+                {
+                    pending.push_back(sub);
+                    add(instruction, matches[sub].length, i);
+                    break;
+                }
+            }
+            break;
+        case Op::Asterisks:
+        case Op::Plus:
+        {
+            /*
+             * The repetition at the end of a match covers the rest.
+             */
+            size_t length = 0;
+            auto sub = find(children[0], position);
+            if (sub == NONE && current.op == Op::Plus)
+            {
+                return;
+            }
+            while (sub != NONE)
+            {
+                pending.push_back(sub);
+                if (matches[sub].length == 0)
+                {
+                    break;
+                }
+                length += matches[sub].length;
+                auto rest = find(instruction, position + length);
+                if (rest != NONE)
+                {
+                    pending.push_back(rest);
+                    length += matches[rest].length;
+                    break;
+                }
+                sub = find(children[0], position + length);
+            }
+            add(instruction, length, 0);
+            break;
+        }
+        case Op::Optional:
+        {
+            auto sub = find(children[0], position);
+            if (sub != NONE)
+            {
+                pending.push_back(sub);
+            }
+            add(instruction, sub != NONE ? matches[sub].length : 0, 0);
+            break;
+        }
+        case Op::FollowedBy:
+            if (find(children[0], position) != NONE)
+            {
+                add(instruction, 0, 0);
+            }
+            break;
+        case Op::NotFollowedBy:
+            if (find(children[0], position) == NONE)
+            {
+                add(instruction, 0, 0);
+            }
+            break;
+        case Op::Set:
+            if (position < input.size() &&
+                grammar.contains(current.first, input[position]))
+            {
+                add(instruction, 1, 0);
+            }
+            break;
+        case Op::String:
+            if (input.substr(position, current.count) ==
+                std::string_view{grammar.literals}.substr(
+                    current.first, current.count))
+            {
+                add(instruction, current.count, 0);
+            }
+            break;
+    }
+}
+
+void pika::peg::PikaTable::compact()
+{
+    std::vector<uint32_t> moved(matches.size(), NONE);
+    std::vector<uint32_t> stack;
+    for (auto& i : memo)
+    {
+        stack.push_back(i.second);
+    }
+    while (!stack.empty())
+    {
+        auto current = stack.back();
+        stack.pop_back();
+        if (moved[current] != NONE)
+        {
+            continue;
+        }
+        moved[current] = 0;
+        auto& match = matches[current];
+        stack.insert(
+            stack.end(),
+            submatches.begin() + match.first,
+            submatches.begin() + match.first + match.count);
+    }
+    std::vector<Match> kept;
+    for (size_t i = 0; i < matches.size(); ++i)
+    {
+        if (moved[i] != NONE)
+        {
+            moved[i] = static_cast<uint32_t>(kept.size());
+            kept.push_back(matches[i]);
+        }
+    }
+    std::vector<uint32_t> kept_submatches;
+    for (auto& i : kept)
+    {
+        auto first = static_cast<uint32_t>(kept_submatches.size());
+        for (uint32_t j = 0; j < i.count; ++j)
+        {
+            kept_submatches.push_back(moved[submatches[i.first + j]]);
+        }
+        i.first = first;
+    }
+    for (auto& i : memo)
+    {
+        i.second = moved[i.second];
+    }
+    matches = std::move(kept);
+    submatches = std::move(kept_submatches);
+    replaced = 0;
+}
+
+void pika::peg::PikaTable::match()
+{
+    for (auto column = position + 1; column > 0; --column)
+    {
+        position = column - 1;
+        auto symbol = position < input.size() ?
+            static_cast<unsigned char>(input[position]) :
+            size_t{256};
+        for (auto i : grammar.seeds[symbol])
+        {
+            queue.emplace(grammar.order[i], i);
+        }
+        while (!queue.empty())
+        {
+            auto top = queue.top().second;
+            queue.pop();
+            evaluate(top);
+        }
+        if (2 * replaced > matches.size())
+        {
+            compact();
+        }
+    }
+}
+
+size_t pika::peg::PikaTable::lookup(uint32_t rule, size_t index) const
+{
+    auto found = find(grammar.rules[rule].body, index);
+    return found == NONE ? NO_MATCH : matches[found].length;
+}
+
+/*
+ * The rest of a repetition is flattened into it, like in
+ * parse_tree::TreeNode.
+ */
+void pika::peg::PikaTable::collect(
+    uint32_t match, size_t index, bool node, std::vector<Node>& output) const
+{
+    auto& current = matches[match];
+    auto rule = grammar.instructions[current.instruction].rule;
+    auto* into = &output;
+    if (node && rule != Grammar::NO_RULE && grammar.rules[rule].active)
+    {
+        output.push_back({rule, index, current.length, {}});
+        into = &output.back().children;
+    }
+    for (uint32_t i = 0; i < current.count; ++i)
+    {
+        auto sub = submatches[current.first + i];
+        collect(
+            sub, index, matches[sub].instruction != current.instruction, *into);
+        index += matches[sub].length;
+    }
+}
+
+std::optional<pika::peg::Node>
+pika::peg::PikaTable::parse(uint32_t rule, size_t index) const
+{
+    auto found = find(grammar.rules[rule].body, index);
+    if (found == NONE)
+    {
+        return std::nullopt;
+    }
+    std::vector<Node> nodes;
+    collect(found, index, true, nodes);
+    if (grammar.rules[rule].active)
+    {
+        return std::move(nodes[0]);
+    }
+    return Node{rule, index, matches[found].length, std::move(nodes)};
+}
+
+size_t pika::peg::PikaTable::entries() const noexcept
+{
+    return memo.size();
+}
+
+size_t pika::peg::PikaTable::held() const noexcept
+{
+    return matches.size();
+}
@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <pika/statistics.hpp>
+
+pika::statistics::ClauseStatistics&
+pika::statistics::Statistics::operator[](size_t clause_id)
+{
+    if (clause_id >= clauses.size())
+    {
+        clauses.resize(clause_id + 1);
+    }
+    return clauses[clause_id];
+}
+
+pika::statistics::ClauseStatistics&
+pika::statistics::Statistics::operator[](const clause::Clause* clause)
+{
+    auto& entry = (*this)[clause->clause_id()];
+    entry.clause = clause;
+    return entry;
+}
+
+const pika::statistics::ClauseStatistics*
+pika::statistics::Statistics::find(const clause::Clause* clause) const
+{
+    auto id = clause->clause_id();
+    if (id >= clauses.size() || !clauses[id].clause)
+    {
+        return nullptr;
+    }
+    return &clauses[id];
+}
+
+std::vector<pika::statistics::ClauseStatistics>
+pika::statistics::Statistics::collect() const
+{
+    std::vector<ClauseStatistics> result;
+    for (auto& i : clauses)
+    {
+        if (i.clause)
+        {
+            result.push_back(i);
+        }
+    }
+    std::stable_sort(
+        result.begin(),
+        result.end(),
+        [](const ClauseStatistics& a, const ClauseStatistics& b) {
+            return a.evaluations > b.evaluations;
+        });
+    return result;
+}
+
+void pika::statistics::Statistics::clear() noexcept
+{
+    clauses.clear();
+}
+
+void pika::statistics::Statistics::dump(std::ostream& output) const
+{
+    for (auto& i : collect())
+    {
+        if (i.clause->label())
+        {
+            output << i.clause->label().value() << " <- ";
+        }
+        output << i.clause->display() << ": evaluations=" << i.evaluations
+               << ", matches=" << i.matches
+               << ", improvements=" << i.improvements
+               << ", rejections=" << i.rejections << ", pushes=" << i.pushes
+               << ", duplicates=" << i.duplicates << ", hits=" << i.hits
+               << ", misses=" << i.misses << std::endl;
+    }
+}
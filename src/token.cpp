@@ -0,0 +1,90 @@
+#include <limits>
+#include <pika/analysis.hpp>
+#include <pika/token.hpp>
+
+pika::token::TokenStream::TokenStream(std::string_view source) : source(source)
+{}
+
+void pika::token::TokenStream::push(uint8_t kind, size_t start, size_t length)
+{
+    kinds.push_back(static_cast<char>(kind));
+    spans.emplace_back(start, start + length);
+}
+
+std::string_view pika::token::TokenStream::symbols() const noexcept
+{
+    return kinds;
+}
+
+size_t pika::token::TokenStream::size() const noexcept
+{
+    return kinds.size();
+}
+
+std::string_view
+pika::token::TokenStream::source_span(size_t position, size_t count) const
+{
+    auto start = position < spans.size() ? spans[position].first :
+                                           source.size();
+    if (count == 0)
+    {
+        return source.substr(start, 0);
+    }
+    return source.substr(start, spans[position + count - 1].second - start);
+}
+
+std::string_view
+pika::token::TokenStream::source_span(std::string_view matched) const
+{
+    return source_span(
+        static_cast<size_t>(matched.data() - kinds.data()), matched.size());
+}
+
+bool pika::token::Lexer::add(int kind, const clause::Clause& clause)
+{
+    if (kind != SKIP &&
+        (kind < 0 || kind > std::numeric_limits<uint8_t>::max()))
+    {
+        return false;
+    }
+    analysis::Analysis analysis{clause};
+    auto automaton = dfa::Dfa::compile(clause, analysis);
+    if (!automaton)
+    {
+        return false;
+    }
+    rules.push_back({kind, std::move(*automaton)});
+    return true;
+}
+
+std::optional<pika::token::TokenStream>
+pika::token::Lexer::tokenize(std::string_view source) const
+{
+    TokenStream result(source);
+    size_t position = 0;
+    while (position < source.size())
+    {
+        const Rule* best = nullptr;
+        size_t longest = 0;
+        for (auto& i : rules)
+        {
+            size_t depends = 0;
+            auto length = i.automaton.match(source, position, depends);
+            if (length != dfa::Dfa::NO_MATCH && length > longest)
+            {
+                best = &i;
+                longest = length;
+            }
+        }
+        if (!best)
+        {
+            return std::nullopt;
+        }
+        if (best->kind != SKIP)
+        {
+            result.push(static_cast<uint8_t>(best->kind), position, longest);
+        }
+        position += longest;
+    }
+    return result;
+}
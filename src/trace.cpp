@@ -0,0 +1,135 @@
+#include <iomanip>
+#include <pika/trace.hpp>
+
+pika::trace::Tracer::Tracer(size_t capacity)
+: capacity(capacity), origin(limits::Clock::now())
+{
+    events.reserve(std::min<size_t>(capacity, 1 << 16));
+}
+
+void pika::trace::Tracer::record(const Event& event)
+{
+    if (events.size() < capacity)
+    {
+        events.push_back(event);
+    }
+    else
+    {
+        dropped_events += 1;
+    }
+}
+
+void pika::trace::Tracer::column(
+    size_t position,
+    limits::Clock::time_point start,
+    size_t queue_depth,
+    size_t evaluations)
+{
+    record(
+        {nullptr,
+         position,
+         queue_depth,
+         evaluations,
+         start,
+         limits::Clock::now() - start});
+}
+
+void pika::trace::Tracer::clause(
+    const clause::Clause* clause,
+    size_t position,
+    limits::Clock::time_point start)
+{
+    record({clause, position, 0, 1, start, limits::Clock::now() - start});
+}
+
+const std::vector<pika::trace::Event>&
+pika::trace::Tracer::get_events() const noexcept
+{
+    return events;
+}
+
+size_t pika::trace::Tracer::dropped() const noexcept
+{
+    return dropped_events;
+}
+
+void pika::trace::Tracer::clear() noexcept
+{
+    events.clear();
+    dropped_events = 0;
+    origin = limits::Clock::now();
+}
+
+static void write_string(std::ostream& output, std::string_view string)
+{
+    output << '"';
+    for (char c : string)
+    {
+        if (c == '"' || c == '\\')
+        {
+            output << '\\' << c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            output << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                   << static_cast<int>(c) << std::dec << std::setfill(' ');
+        }
+        else
+        {
+            output << c;
+        }
+    }
+    output << '"';
+}
+
+static void write_microseconds(
+    std::ostream& output, pika::limits::Clock::duration duration)
+{
+    auto nanoseconds =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    output << nanoseconds / 1000 << '.' << std::setw(3) << std::setfill('0')
+           << (nanoseconds < 0 ? -nanoseconds : nanoseconds) % 1000
+           << std::setfill(' ');
+}
+
+void pika::trace::Tracer::write(std::ostream& output) const
+{
+    output << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (auto& i : events)
+    {
+        output << (first ? "\n" : ",\n");
+        first = false;
+        output << "{\"name\":";
+        if (!i.clause)
+        {
+            write_string(output, "column");
+        }
+        else
+        {
+            write_string(
+                output,
+                i.clause->label() ? i.clause->label().value()
+                                  : i.clause->display());
+        }
+        output << ",\"cat\":\"" << (i.clause ? "packrat" : "pika")
+               << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":";
+        write_microseconds(output, i.start - origin);
+        output << ",\"dur\":";
+        write_microseconds(output, i.duration);
+        output << ",\"args\":{\"position\":" << i.position;
+        if (!i.clause)
+        {
+            output << ",\"queue_depth\":" << i.queue_depth
+                   << ",\"evaluations\":" << i.evaluations;
+        }
+        output << "}}";
+        if (!i.clause)
+        {
+            output << ",\n{\"name\":\"queue\",\"ph\":\"C\",\"pid\":1,\"ts\":";
+            write_microseconds(output, i.start - origin);
+            output << ",\"args\":{\"depth\":" << i.queue_depth << "}}";
+        }
+    }
+    output << "\n]}" << std::endl;
+}
@@ -1,9 +1,15 @@
 #include <gtest/gtest.h>
-#define PIKA_DEBUG
+#include "test_analysis.hpp"
 #include "test_clause.hpp"
+#include "test_dfa.hpp"
 #include "test_graph.hpp"
+#include "test_limits.hpp"
 #include "test_memotable.hpp"
 #include "test_parse_tree.hpp"
+#include "test_peg.hpp"
+#include "test_statistics.hpp"
+#include "test_token.hpp"
+#include "test_trace.hpp"
 int main(int argc, char** argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,84 @@
+#ifndef PIKA_TEST_ANALYSIS_HPP
+#define PIKA_TEST_ANALYSIS_HPP
+
+#include "test_clause.hpp"
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <pika/analysis.hpp>
+#include <pika/graph.hpp>
+
+static pika::analysis::SymbolSet symbols(std::string_view bytes)
+{
+    pika::analysis::SymbolSet result;
+    for (char c : bytes)
+    {
+        result.set(static_cast<unsigned char>(c));
+    }
+    return result;
+}
+
+TEST(Analysis, FirstSets)
+{
+    pika::analysis::Analysis analysis{Toplevel()};
+    auto digits = symbols("0123456789");
+
+    auto number = analysis[Number()];
+    EXPECT_EQ(number.first, digits);
+    EXPECT_FALSE(number.nullable);
+
+    auto toplevel = analysis[Toplevel()];
+    EXPECT_EQ(toplevel.first, digits | symbols("("));
+    EXPECT_FALSE(toplevel.nullable);
+    EXPECT_TRUE(analysis.viable(Additive(), '('));
+    EXPECT_FALSE(analysis.viable(Additive(), ')'));
+    EXPECT_FALSE(analysis.viable(Additive(), pika::analysis::END_OF_INPUT));
+
+    auto end = analysis[PIKA_NOT_FOLLOWED_BY(PIKA_ANY)()];
+    EXPECT_TRUE(end.nullable);
+    EXPECT_EQ(end.first.count(), 1);
+    EXPECT_TRUE(end.first.test(pika::analysis::END_OF_INPUT));
+
+    pika::analysis::Analysis statements{LooseStatements()};
+    auto loose = statements[LooseStatements()];
+    EXPECT_TRUE(loose.nullable);
+    EXPECT_EQ(
+        loose.first,
+        digits | pika::analysis::SymbolSet{}.set(pika::analysis::END_OF_INPUT));
+}
+
+TEST(Analysis, Pruning)
+{
+    for (auto input : {"12+(3*4)", "1+)", "(((1)))", "1+2+"})
+    {
+        /*
+         * Besides `^` and ANYCHAR, a column only seeds the terminal matching
+         * its byte, and the end of input only `^` and the final lookahead.
+         */
+        auto table = pika::graph::construct_table(Toplevel(), input, false);
+        auto& seeds = table.seeds;
+        EXPECT_EQ(seeds['x'].size(), 2);
+        ASSERT_EQ(seeds['1'].size(), 3);
+        auto digit = Digit().get_instance();
+        EXPECT_NE(
+            std::find(seeds['1'].begin(), seeds['1'].end(), digit),
+            seeds['1'].end());
+        EXPECT_EQ(seeds[')'].size(), 3);
+        EXPECT_EQ(seeds[pika::analysis::END_OF_INPUT].size(), 2);
+        auto pika = table.match();
+        pika::memotable::MemoTable memo(input, Toplevel());
+        auto packrat = Toplevel().packrat_match(memo, 0);
+        ASSERT_EQ(static_cast<bool>(pika), static_cast<bool>(packrat));
+        if (pika)
+        {
+            EXPECT_EQ(pika->get_length(), packrat->get_length());
+        }
+    }
+    /*
+     * An alternative holding a cut is tried even though it fails.
+     */
+    pika::memotable::MemoTable committed("ac", Committed());
+    EXPECT_FALSE(Committed().packrat_match(committed, 0));
+}
+
+#endif // PIKA_TEST_ANALYSIS_HPP
@@ -189,4 +189,219 @@ TEST(Clause, PackratMatch)
     }
 }
 
+PIKA_DECLARE(
+    Committed,
+    PIKA_ORD(PIKA_SEQ(PIKA_CHAR('a'), PIKA_CUT, PIKA_CHAR('b')), PIKA_CHAR('a')),
+    true);
+PIKA_DECLARE(Statement, PIKA_SEQ(Number, PIKA_CHAR(';'), PIKA_CUT), true);
+PIKA_DECLARE(
+    Statements,
+    PIKA_SEQ(PIKA_ASTERISKS(Statement), PIKA_NOT_FOLLOWED_BY(PIKA_ANY)),
+    true);
+PIKA_DECLARE(
+    LooseStatements,
+    PIKA_SEQ(
+        PIKA_ASTERISKS(PIKA_SEQ(Number, PIKA_CHAR(';'))),
+        PIKA_NOT_FOLLOWED_BY(PIKA_ANY)),
+    true);
+
+TEST(Clause, PackratCut)
+{
+    {
+        pika::memotable::MemoTable table("ab");
+        EXPECT_TRUE(Committed().packrat_match(table, 0));
+    }
+    {
+        pika::memotable::MemoTable table("ac");
+        EXPECT_FALSE(Committed().packrat_match(table, 0));
+    }
+    std::string input;
+    for (size_t i = 0; i < 10000; ++i)
+    {
+        input.append(std::to_string(i)).push_back(';');
+    }
+    pika::memotable::MemoTable table(input);
+    auto result = Statements().packrat_match(table, 0);
+    ASSERT_TRUE(result);
+    EXPECT_EQ(result->get_length(), input.size());
+    pika::memotable::MemoTable loose(input);
+    EXPECT_TRUE(LooseStatements().packrat_match(loose, 0));
+    EXPECT_LT(table.packrat_size() * 20, loose.packrat_size());
+    input.push_back('x');
+    pika::memotable::MemoTable broken(input);
+    EXPECT_FALSE(Statements().packrat_match(broken, 0));
+}
+
+PIKA_DECLARE(
+    Keyword, PIKA_ORD(PIKA_STRING("while"), PIKA_STRING("when")), true);
+PIKA_DECLARE(
+    KeywordList,
+    PIKA_SEQ(
+        PIKA_PLUS(PIKA_SEQ(Keyword, PIKA_OPTIONAL(PIKA_CHAR(' ')))),
+        PIKA_NOT_FOLLOWED_BY(PIKA_ANY)),
+    true);
+
+TEST(Clause, String)
+{
+    EXPECT_EQ(PIKA_STRING("while")().display(), "\"while\"");
+    EXPECT_EQ(PIKA_STRING("while")().literal(), "while");
+    EXPECT_EQ(
+        PIKA_STRING("while")().get_base_type(),
+        pika::type_utils::BaseType::String);
+    auto input = "when while whilewhen";
+    pika::memotable::MemoTable table(input);
+    auto result = KeywordList().packrat_match(table, 0);
+    ASSERT_TRUE(result);
+    EXPECT_EQ(result->get_length(), 20);
+    pika::memotable::MemoTable truncated("when whil");
+    EXPECT_FALSE(KeywordList().packrat_match(truncated, 0));
+
+    auto pika = pika::graph::construct_table(KeywordList(), input);
+    result = pika.match();
+    ASSERT_TRUE(result);
+    EXPECT_EQ(result->get_length(), 20);
+    size_t occurrences = 0;
+    for (auto& i : pika.memo_table)
+    {
+        if (i.first.get_base_type() == pika::type_utils::BaseType::String)
+        {
+            occurrences += 1;
+        }
+    }
+    EXPECT_EQ(occurrences, 4);
+
+    /*
+     * The column of a literal depends on all the bytes it compared.
+     */
+    auto partial = pika::graph::construct_table(KeywordList(), "whil");
+    EXPECT_FALSE(partial.match());
+    EXPECT_TRUE(partial.reparse({4, 4, "e"}, "while"));
+}
+
+PIKA_DECLARE(
+    Identifier,
+    PIKA_SEQ(
+        PIKA_CHAR_SET("a-zA-Z_"),
+        PIKA_ASTERISKS(PIKA_CHAR_SET("a-zA-Z_0-9"))),
+    true);
+PIKA_DECLARE(
+    Operators,
+    PIKA_SEQ(
+        PIKA_PLUS(PIKA_SEQ(Identifier, PIKA_OPTIONAL(PIKA_CHAR_SET("+-")))),
+        PIKA_NOT_FOLLOWED_BY(PIKA_ANY)),
+    true);
+
+TEST(Clause, CharSet)
+{
+    using Operator = PIKA_CHAR_SET("+-");
+    EXPECT_TRUE(Operator::contains('+'));
+    EXPECT_TRUE(Operator::contains('-'));
+    EXPECT_FALSE(Operator::contains(','));
+    using Word = PIKA_CHAR_SET("a-zA-Z_");
+    EXPECT_EQ(Word().display(), "[a-zA-Z_]");
+    EXPECT_TRUE(Word::contains('q') && Word::contains('Q'));
+    EXPECT_FALSE(Word::contains('-') || Word::contains('\xff'));
+
+    auto input = "_a1+B-zz9";
+    pika::memotable::MemoTable table(input);
+    auto result = Operators().packrat_match(table, 0);
+    ASSERT_TRUE(result);
+    EXPECT_EQ(result->get_length(), 9);
+    pika::memotable::MemoTable broken("a+9");
+    EXPECT_FALSE(Operators().packrat_match(broken, 0));
+
+    auto pika = pika::graph::construct_table(Operators(), input);
+    result = pika.match();
+    ASSERT_TRUE(result);
+    EXPECT_EQ(result->get_length(), 9);
+    size_t entries = 0;
+    for (auto& i : pika.memo_table)
+    {
+        if (i.first.get_base_type() == pika::type_utils::BaseType::CharSet)
+        {
+            entries += 1;
+        }
+    }
+    /*
+     * One entry per byte and class it belongs to.
+     */
+    EXPECT_EQ(entries, 14);
+}
+
+PIKA_DECLARE(
+    Date,
+    PIKA_SEQ(
+        PIKA_REPEAT(Digit, 4, 4),
+        PIKA_CHAR('-'),
+        PIKA_REPEAT(Digit, 2, 2),
+        PIKA_CHAR('-'),
+        PIKA_REPEAT(Digit, 2, 2)),
+    true);
+PIKA_DECLARE(Hex, PIKA_CHAR_SET("0-9a-f"), true);
+PIKA_DECLARE(
+    Escape,
+    PIKA_SEQ(PIKA_STRING("\\x"), PIKA_REPEAT(Hex, 1, 2)),
+    true);
+PIKA_DECLARE(
+    Stamp,
+    PIKA_SEQ(
+        Date,
+        PIKA_REPEAT(PIKA_SEQ(PIKA_CHAR(' '), Escape), 0, 2),
+        PIKA_NOT_FOLLOWED_BY(PIKA_ANY)),
+    true);
+
+TEST(Clause, Repeat)
+{
+    using Year = PIKA_REPEAT(Digit, 4, 4);
+    EXPECT_EQ(Year().display(), "( Digit ){4,4}");
+    EXPECT_TRUE(pika::clause::_internal::ByteClass<Digit>::value);
+    EXPECT_TRUE(pika::clause::_internal::ByteClass<Hex>::value);
+    EXPECT_FALSE(pika::clause::_internal::ByteClass<Escape>::value);
+
+    std::vector<std::pair<std::string_view, bool>> tests = {
+        {"2020-10-21", true},
+        {"2020-10-21 \\x4 \\xff", true},
+        {"2020-10-21 \\x4 \\xff \\x0", false},
+        {"2020-10-21 \\xfff", false},
+        {"2020-10-21 \\x", false},
+        {"2020-1-21", false},
+        {"20201-10-21", false}};
+    for (auto& i : tests)
+    {
+        pika::memotable::MemoTable table(i.first);
+        auto packrat = Stamp().packrat_match(table, 0);
+        auto pika = pika::graph::construct_table(Stamp(), i.first);
+        auto result = pika.match();
+        EXPECT_EQ(static_cast<bool>(packrat), i.second) << i.first;
+        EXPECT_EQ(static_cast<bool>(result), i.second) << i.first;
+        if (packrat && result)
+        {
+            EXPECT_EQ(packrat->get_length(), i.first.size());
+            EXPECT_EQ(result->get_length(), i.first.size());
+        }
+    }
+
+    /*
+     * A scanned repetition keeps a sub-match per byte only for an active
+     * byte class.
+     */
+    auto pika = pika::graph::construct_table(Stamp(), "2020-10-21 \\xff");
+    ASSERT_TRUE(pika.match());
+    size_t digits = 0, hex = 0;
+    for (auto& i : pika.memo_table)
+    {
+        if (typeid(*i.first.tag) == typeid(PIKA_REPEAT(Digit, 2, 2)))
+        {
+            digits += i.second->sub_matches.size();
+        }
+        else if (typeid(*i.first.tag) == typeid(PIKA_REPEAT(Hex, 1, 2)))
+        {
+            EXPECT_EQ(i.second->sub_matches.size(), i.second->length);
+            hex += 1;
+        }
+    }
+    EXPECT_EQ(digits, 0);
+    EXPECT_GT(hex, 0);
+}
+
 #endif // PIKA_TEST_CLAUSE_HPP
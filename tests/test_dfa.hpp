@@ -0,0 +1,150 @@
+#ifndef PIKA_TEST_DFA_HPP
+#define PIKA_TEST_DFA_HPP
+
+#include "test_clause.hpp"
+#include "test_parse_tree.hpp"
+
+#include <gtest/gtest.h>
+#include <pika/dfa.hpp>
+#include <pika/graph.hpp>
+
+PIKA_DECLARE(Version, PIKA_SEQ(Number, PIKA_CHAR('.'), Number), true);
+PIKA_DECLARE(Bit, PIKA_ORD(PIKA_CHAR('0'), PIKA_CHAR('1')), true);
+PIKA_DECLARE(
+    Release,
+    PIKA_SEQ(
+        Version,
+        PIKA_ASTERISKS(PIKA_SEQ(PIKA_CHAR(','), Version)),
+        PIKA_CHAR(':'),
+        PIKA_PLUS(Bit),
+        PIKA_NOT_FOLLOWED_BY(PIKA_ANY)),
+    true);
+
+TEST(Dfa, Compile)
+{
+    pika::analysis::Analysis analysis{Toplevel()};
+    auto number = pika::dfa::Dfa::compile(Number(), analysis);
+    ASSERT_TRUE(number);
+    size_t depends = 0;
+    EXPECT_EQ(number->match("x123+4", 1, depends), 3);
+    EXPECT_EQ(depends, 4);
+    EXPECT_EQ(number->match("x123", 1, depends), 3);
+    EXPECT_EQ(depends, 4);
+    EXPECT_EQ(number->match("x123", 0, depends), number->NO_MATCH);
+    EXPECT_EQ(depends, 1);
+    EXPECT_FALSE(pika::dfa::Dfa::compile(Additive(), analysis));
+
+    /*
+     * Scanning a run of digits from each of its columns, right to left,
+     * steps through every position once in each of the two states.
+     */
+    std::string digits(1000, '7');
+    digits += "+1";
+    pika::dfa::Scans scans;
+    for (size_t i = digits.size(); i > 0; --i)
+    {
+        size_t expected_depends = 0;
+        auto expected = number->match(digits, i - 1, expected_depends);
+        EXPECT_EQ(number->match(digits, i - 1, depends, scans), expected);
+        EXPECT_EQ(depends, expected_depends);
+    }
+    EXPECT_LE(scans.size(), 2 * digits.size());
+
+    pika::analysis::Analysis stamps{Stamp()};
+    auto date = pika::dfa::Dfa::compile(Date(), stamps);
+    ASSERT_TRUE(date);
+    EXPECT_EQ(date->match("2020-10-21 \\x0", 0, depends), 10);
+    EXPECT_EQ(date->match("2020-10-2", 0, depends), date->NO_MATCH);
+    EXPECT_FALSE(pika::dfa::Dfa::compile(Stamp(), stamps));
+
+    /*
+     * Choices that are not decided by the next byte are left to the
+     * engines: PEG matching commits to "a" where the longest match would
+     * not.
+     */
+    using Greedy = PIKA_SEQ(PIKA_OPTIONAL(PIKA_CHAR('a')), PIKA_CHAR('a'));
+    pika::analysis::Analysis greedy{Greedy()};
+    EXPECT_FALSE(pika::dfa::Dfa::compile(Greedy(), greedy));
+    pika::analysis::Analysis keywords{KeywordList()};
+    EXPECT_FALSE(pika::dfa::Dfa::compile(Keyword(), keywords));
+}
+
+TEST(Dfa, Engine)
+{
+    for (auto input : {"12+(3*4)", "1+)", "(((1)))", "1+2+", "19*7+1"})
+    {
+        auto compiled = pika::graph::construct_table(Toplevel(), input);
+        auto plain = pika::graph::construct_table(Toplevel(), input, false);
+        auto expected = plain.match();
+        auto result = compiled.match();
+        ASSERT_EQ(static_cast<bool>(result), static_cast<bool>(expected));
+        if (result)
+        {
+            EXPECT_EQ(result->get_length(), expected->get_length());
+            EXPECT_EQ(
+                eval(pika::parse_tree::TreeNode(*result, compiled.memo_table)),
+                eval(pika::parse_tree::TreeNode(*expected, plain.memo_table)));
+        }
+        /*
+         * Digits are only looked at by the automaton of Number.
+         */
+        EXPECT_TRUE(compiled.compiled[Number().clause_id()]);
+        for (auto& i : compiled.memo_table)
+        {
+            EXPECT_NE(i.first.tag, Digit().get_instance());
+        }
+        EXPECT_LT(compiled.memo_table.size(), plain.memo_table.size());
+    }
+
+    /*
+     * Trees are rebuilt inside compiled matches, active clauses and chosen
+     * alternatives included.
+     */
+    auto input = "1.2,10.0:101";
+    auto table = pika::graph::construct_table(Release(), input);
+    auto result = table.match();
+    ASSERT_TRUE(result);
+    EXPECT_EQ(result->get_length(), 12);
+    pika::parse_tree::TreeNode tree(*result, table.memo_table);
+    std::vector<size_t> numbers;
+    std::vector<size_t> bits;
+    for (auto& i : tree)
+    {
+        if (i->is_clause<Version>())
+        {
+            for (auto& j : *i)
+            {
+                EXPECT_TRUE(j->is_clause<Number>());
+                numbers.push_back(eval(*j));
+            }
+        }
+        else
+        {
+            EXPECT_TRUE(i->is_clause<Bit>());
+            bits.push_back(i->alternative);
+        }
+    }
+    EXPECT_EQ(numbers, (std::vector<size_t>{1, 2, 10, 0}));
+    EXPECT_EQ(bits, (std::vector<size_t>{1, 0, 1}));
+
+    /*
+     * A compiled column depends on every byte its automaton looked at.
+     */
+    auto partial = pika::graph::construct_table(Release(), "1.2,10");
+    EXPECT_FALSE(partial.match());
+    EXPECT_TRUE(partial.reparse({6, 6, ".0:1"}, "1.2,10.0:1"));
+
+    /*
+     * A compiled match its clause does not find again is an error, not a
+     * tree of the wrong shape.
+     */
+    pika::memotable::MemoTable memo("12");
+    pika::memotable::Match bogus(
+        pika::memotable::MemoKey(Number().get_instance(), 0),
+        1,
+        pika::memotable::Match::UNEXPANDED,
+        std::vector<std::shared_ptr<pika::memotable::Match>>{});
+    EXPECT_THROW(pika::parse_tree::TreeNode(bogus, memo), std::logic_error);
+}
+
+#endif // PIKA_TEST_DFA_HPP
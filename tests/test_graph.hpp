@@ -7,6 +7,7 @@
 #include "test_clause.hpp"
 #include "test_parse_tree.hpp"
 
+#include <deque>
 #include <pika/graph.hpp>
 
 TEST(Graph, ConstructTable)
@@ -133,4 +134,273 @@ TEST(Graph, List2)
     PARSE(List2, as, as, extract);
 }
 
+#define REPARSE(RULE, STR, START, END, REPLACEMENT, RES, EVAL) \
+    { \
+        std::string original = STR; \
+        std::string updated = original; \
+        updated.replace(START, END - START, REPLACEMENT); \
+        auto table = pika::graph::construct_table(RULE(), original); \
+        table.match(); \
+        auto result = table.reparse({START, END, REPLACEMENT}, updated); \
+        EXPECT_TRUE(result); \
+        auto tree = pika::parse_tree::TreeNode(*result, table.memo_table); \
+        EXPECT_EQ(EVAL(tree), RES); \
+        auto fresh = pika::graph::construct_table(RULE(), updated); \
+        fresh.match(); \
+        EXPECT_EQ(table.memo_table.size(), fresh.memo_table.size()); \
+    }
+
+TEST(Graph, Reparse)
+{
+    REPARSE(Toplevel, "1+1*2", 2, 3, "3", 7, eval);
+    REPARSE(Toplevel, "1+1*2", 5, 5, "+10", 13, eval);
+    REPARSE(Toplevel, "1+1*2", 0, 0, "(4*5)+", 23, eval);
+    REPARSE(Toplevel, "(1+2)*3+4", 1, 4, "7", 25, eval);
+    REPARSE(Toplevel, "(1+2)*3+4", 5, 7, "", 7, eval);
+    REPARSE(Toplevel, "(1+2)*3+4", 0, 6, "", 7, eval);
+    REPARSE(Add, "1+555+1+1", 4, 4, "5", 5558, eval);
+    REPARSE(List, "aaabaaa", 3, 4, "a", "aaaaaaa", extract);
+    REPARSE(MyString, "cacacbdb", 6, 7, "c", "cacacbcb", extract);
+
+    /*
+     * Edits on either side of the previous one agree with a fresh parse.
+     */
+    std::vector<std::tuple<size_t, size_t, std::string>> edits = {
+        {8, 9, "5*6"},
+        {1, 2, "10"},
+        {12, 12, "+7"},
+        {0, 0, "2*"},
+        {2, 8, "4"},
+        {9, 11, ""},
+        {0, 1, "1"}};
+    std::deque<std::string> buffers{"(1+2)*3+4"};
+    auto table = pika::graph::construct_table(Toplevel(), buffers.back());
+    table.match();
+    for (auto& [start, end, replacement] : edits)
+    {
+        auto updated = buffers.back();
+        updated.replace(start, end - start, replacement);
+        buffers.push_back(updated);
+        auto result =
+            table.reparse({start, end, replacement}, buffers.back());
+        ASSERT_TRUE(result);
+        auto fresh = pika::graph::construct_table(Toplevel(), updated);
+        ASSERT_TRUE(fresh.match());
+        EXPECT_EQ(
+            eval(pika::parse_tree::TreeNode(*result, table.memo_table)),
+            eval(pika::parse_tree::TreeNode(
+                *fresh.result(), fresh.memo_table)));
+        EXPECT_EQ(table.memo_table.size(), fresh.memo_table.size());
+        result.reset();
+        EXPECT_EQ(table.memory_usage(), table.measure_memory());
+    }
+
+    /*
+     * Only the replaced columns are matched again when nothing left of the
+     * edit looked into them.
+     */
+    std::string chain = "1";
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        chain.append("+1");
+    }
+    auto long_table = pika::graph::construct_table(Toplevel(), chain);
+    long_table.match();
+    auto columns = long_table.memo_table.counters.columns;
+    std::string updated = "2" + chain.substr(1);
+    auto result = long_table.reparse({0, 1, "2"}, updated);
+    ASSERT_TRUE(result);
+    EXPECT_EQ(long_table.memo_table.counters.columns - columns, 2);
+    EXPECT_EQ(
+        eval(pika::parse_tree::TreeNode(*result, long_table.memo_table)),
+        1002);
+
+    /*
+     * Edits far apart from each other leave the entries between them in
+     * place, so an edit at the start still only matches two columns after
+     * one at the end.
+     */
+    std::deque<std::string> chains{updated};
+    std::vector<std::tuple<size_t, size_t, std::string>> far = {
+        {2000, 2001, "3"}, {2, 2, "5+"}, {1000, 1001, "4"}, {0, 1, "1"}};
+    for (auto& [start, end, replacement] : far)
+    {
+        auto next = chains.back();
+        next.replace(start, end - start, replacement);
+        chains.push_back(next);
+        result = long_table.reparse({start, end, replacement}, chains.back());
+        ASSERT_TRUE(result);
+    }
+    EXPECT_EQ(
+        eval(pika::parse_tree::TreeNode(*result, long_table.memo_table)),
+        1011);
+    chains.push_back("2" + chains.back().substr(1));
+    columns = long_table.memo_table.counters.columns;
+    result = long_table.reparse({0, 1, "2"}, chains.back());
+    ASSERT_TRUE(result);
+    EXPECT_EQ(long_table.memo_table.counters.columns - columns, 2);
+    EXPECT_EQ(
+        eval(pika::parse_tree::TreeNode(*result, long_table.memo_table)),
+        1012);
+    EXPECT_EQ(long_table.memory_usage(), long_table.measure_memory());
+
+    EXPECT_THROW(
+        long_table.reparse({5, 4, ""}, chains.back()), std::invalid_argument);
+    EXPECT_THROW(
+        long_table.reparse({0, 1, ""}, chains.back()), std::invalid_argument);
+    auto unfinished = pika::graph::construct_table(Toplevel(), chain);
+    EXPECT_THROW(unfinished.reparse({0, 0, ""}, chain), std::logic_error);
+}
+
+TEST(Graph, Step)
+{
+    auto target = "(1+2)*3+4";
+    auto table = pika::graph::construct_table(Toplevel(), target);
+    auto progress = table.progress();
+    EXPECT_EQ(progress.matched_columns, 0);
+    EXPECT_EQ(progress.total_columns, 10);
+    EXPECT_FALSE(table.result());
+    for (size_t i = 1; !progress.finished(); ++i)
+    {
+        progress = table.step(1);
+        EXPECT_EQ(progress.matched_columns, i);
+    }
+    auto result = table.result();
+    ASSERT_TRUE(result);
+    EXPECT_EQ(eval(pika::parse_tree::TreeNode(*result, table.memo_table)), 13);
+
+    std::string as(1000, 'a');
+    auto timed = pika::graph::construct_table(List2(), as);
+    progress = timed.step(std::chrono::nanoseconds{0});
+    EXPECT_EQ(progress.matched_columns, 1);
+    while (!progress.finished())
+    {
+        progress = timed.step(std::chrono::milliseconds{1});
+    }
+    ASSERT_TRUE(timed.result());
+    EXPECT_EQ(timed.result()->get_length(), 1000);
+}
+
+PIKA_DECLARE(Sign, PIKA_ORD(PIKA_CHAR('-')), false);
+PIKA_DECLARE(Digits, PIKA_SEQ(Number), false);
+PIKA_DECLARE(Spaces, PIKA_ASTERISKS(PIKA_CHAR(' ')), false);
+PIKA_DECLARE(Blank, PIKA_ASTERISKS(PIKA_CHAR(' ')), false);
+PIKA_DECLARE(
+    Signed, PIKA_SEQ(Spaces, PIKA_OPTIONAL(Sign), Digits, Blank), true);
+PIKA_DECLARE(
+    SignedList,
+    PIKA_SEQ(PIKA_FIRST, PIKA_PLUS(Signed), PIKA_NOT_FOLLOWED_BY(PIKA_ANY)),
+    true);
+
+TEST(Graph, MergeClauses)
+{
+    auto table = pika::graph::construct_table(SignedList(), " -12 3  -4 ", false);
+    EXPECT_EQ(
+        table.resolve(Sign().get_instance()),
+        PIKA_CHAR('-')().get_instance());
+    EXPECT_EQ(table.resolve(Digits().get_instance()), Number().get_instance());
+    EXPECT_EQ(table.resolve(Blank().get_instance()), Spaces().get_instance());
+    EXPECT_EQ(table.resolve(Signed().get_instance()), Signed().get_instance());
+    EXPECT_EQ(table.specials.size(), 3);
+
+    auto result = table.match();
+    ASSERT_TRUE(result);
+    EXPECT_EQ(result->get_length(), 11);
+    for (auto& i : table.memo_table)
+    {
+        EXPECT_EQ(table.resolve(i.first.tag), i.first.tag);
+    }
+    auto tree = pika::parse_tree::TreeNode(*result, table.memo_table);
+    ASSERT_EQ(tree.size(), 3);
+    for (auto& i : tree)
+    {
+        EXPECT_TRUE(i->is_clause<Signed>());
+        ASSERT_EQ(i->size(), 1);
+        EXPECT_TRUE((*i->begin())->is_clause<Number>());
+    }
+}
+
+bool same_match(
+    const pika::memotable::Match& lhs, const pika::memotable::Match& rhs)
+{
+    if (!(lhs.key == rhs.key) || lhs.length != rhs.length ||
+        lhs.sub_fst_idx != rhs.sub_fst_idx ||
+        lhs.sub_matches.size() != rhs.sub_matches.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < lhs.sub_matches.size(); ++i)
+    {
+        auto& left = lhs.sub_matches[i];
+        auto& right = rhs.sub_matches[i];
+        if (!left || !right ? left != right : !same_match(*left, *right))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename Rule>
+void expect_length_only(std::string_view input, bool compile = true)
+{
+    auto full = pika::graph::construct_table(Rule(), input, compile);
+    auto expected = full.match();
+    auto lengths = pika::graph::construct_table(Rule(), input, compile);
+    lengths.length_only = true;
+    auto result = lengths.match();
+    ASSERT_EQ(result != nullptr, expected != nullptr) << input;
+    EXPECT_EQ(lengths.memo_table.size(), full.memo_table.size());
+    EXPECT_EQ(
+        lengths.memo_table.counters.evaluations,
+        full.memo_table.counters.evaluations);
+    if (expected)
+    {
+        EXPECT_TRUE(same_match(*result, *expected)) << input;
+    }
+    result = nullptr;
+    EXPECT_EQ(lengths.memory_usage(), lengths.measure_memory());
+}
+
+TEST(Graph, LengthOnly)
+{
+    expect_length_only<Toplevel>("(13*5)*2+14*(1+(5*(1+(2*3))))");
+    expect_length_only<Toplevel>("(13*5)*2+14*(1+(5*(1+(2*3))))", false);
+    expect_length_only<Toplevel>("1+(2*", false);
+    expect_length_only<Add>("1+555+1+1");
+    expect_length_only<List>(std::string(100, 'a') + "b");
+    expect_length_only<List2>("aaab");
+    expect_length_only<MyString>("cacacbdb");
+    expect_length_only<Calculation>("2*3^2+1-4");
+    expect_length_only<Calculation>("2*(3+1)^2", false);
+    expect_length_only<Calculation>("1++2");
+    expect_length_only<SignedList>(" -12 3  -4 ", false);
+
+    auto lengths = pika::graph::construct_table(Calculation(), "2^3^2");
+    lengths.length_only = true;
+    auto result = lengths.match();
+    ASSERT_TRUE(result);
+    EXPECT_EQ(
+        eval(pika::parse_tree::TreeNode(*result, lengths.memo_table)), 512);
+    EXPECT_THROW(lengths.reparse({0, 1, "3"}, "3^3^2"), std::logic_error);
+
+    /*
+     * Each column of a left recursive list grows its entry once per
+     * element to its right. A full table keeps every step referenced from
+     * the next one, a length-only table only the last.
+     */
+    std::string as(1000, 'a');
+    auto full = pika::graph::construct_table(List(), as);
+    full.step(std::numeric_limits<size_t>::max());
+    auto list = pika::graph::construct_table(List(), as);
+    list.length_only = true;
+    list.step(std::numeric_limits<size_t>::max());
+    EXPECT_LT(list.memory_usage() * 10, full.memory_usage());
+    EXPECT_EQ(list.memory_usage(), list.measure_memory());
+    auto tree = list.result();
+    ASSERT_TRUE(tree);
+    EXPECT_EQ(
+        extract(pika::parse_tree::TreeNode(*tree, list.memo_table)), as);
+}
+
 #endif // PIKA_TEST_GRAPH_HPP
@@ -0,0 +1,121 @@
+#ifndef PIKA_TEST_LIMITS_HPP
+#define PIKA_TEST_LIMITS_HPP
+
+#include "test_clause.hpp"
+
+#include <gtest/gtest.h>
+#include <pika/graph.hpp>
+#include <pika/limits.hpp>
+
+#define EXPECT_ABORTED(STATEMENT, REASON) \
+    try \
+    { \
+        STATEMENT; \
+        ADD_FAILURE() << "parse was not aborted"; \
+    } \
+    catch (const pika::limits::Aborted& aborted) \
+    { \
+        EXPECT_EQ(aborted.reason(), REASON); \
+    }
+
+TEST(Limits, Cancellation)
+{
+    pika::limits::CancellationToken token;
+    {
+        auto table = pika::graph::construct_table(Toplevel(), "1+(2*3)");
+        table.memo_table.limits.set_token(token);
+        EXPECT_TRUE(table.match());
+    }
+    token.cancel();
+    {
+        auto table = pika::graph::construct_table(Toplevel(), "1+(2*3)");
+        table.memo_table.limits.set_token(token);
+        table.memo_table.limits.set_interval(16);
+        EXPECT_ABORTED(table.match(), pika::limits::Reason::Cancelled);
+    }
+    {
+        pika::memotable::MemoTable table("1+(2*3)");
+        table.limits.set_token(token);
+        table.limits.set_interval(1);
+        EXPECT_ABORTED(
+            Toplevel().packrat_match(table, 0),
+            pika::limits::Reason::Cancelled);
+    }
+}
+
+TEST(Limits, Deadline)
+{
+    std::string input(2000, '(');
+    input.push_back('1');
+    input.append(2000, ')');
+    {
+        auto table = pika::graph::construct_table(Toplevel(), input);
+        table.memo_table.limits.set_timeout(std::chrono::seconds{-1});
+        EXPECT_ABORTED(table.match(), pika::limits::Reason::DeadlineExceeded);
+    }
+    {
+        pika::memotable::MemoTable table(input);
+        table.limits.set_deadline(pika::limits::Clock::now());
+        EXPECT_ABORTED(
+            Toplevel().packrat_match(table, 0),
+            pika::limits::Reason::DeadlineExceeded);
+    }
+    {
+        pika::memotable::MemoTable table(input);
+        table.limits.set_timeout(std::chrono::hours{1});
+        EXPECT_TRUE(Toplevel().packrat_match(table, 0));
+    }
+}
+
+TEST(Limits, Memory)
+{
+    std::string input;
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        input.append(std::to_string(i)).push_back(';');
+    }
+    {
+        auto table = pika::graph::construct_table(Toplevel(), "1+(2*3)");
+        EXPECT_TRUE(table.match());
+        EXPECT_GT(table.memory_usage(), 0);
+        EXPECT_EQ(table.memory_usage(), table.measure_memory());
+        table.reparse({2, 3, "45"}, "1+(45*3)");
+        EXPECT_EQ(table.memory_usage(), table.measure_memory());
+    }
+    {
+        /*
+         * Matches stay charged until they are freed, not until the memo
+         * lets go of them.
+         */
+        auto table = pika::graph::construct_table(Toplevel(), "1+(2*3)");
+        auto held = table.match();
+        table.reparse({0, 7, "4"}, "4");
+        EXPECT_GT(table.memory_usage(), table.measure_memory());
+        held.reset();
+        EXPECT_EQ(table.memory_usage(), table.measure_memory());
+    }
+    {
+        pika::memotable::MemoTable table(input, Statements());
+        EXPECT_TRUE(Statements().packrat_match(table, 0));
+        EXPECT_EQ(table.memory_usage(), table.measure_memory());
+    }
+    {
+        pika::memotable::MemoTable table(input);
+        EXPECT_TRUE(LooseStatements().packrat_match(table, 0));
+        EXPECT_EQ(table.memory_usage(), table.measure_memory());
+    }
+    {
+        auto table = pika::graph::construct_table(Toplevel(), input);
+        table.memo_table.limits.set_memory_limit(4096);
+        EXPECT_ABORTED(table.match(), pika::limits::Reason::MemoryExceeded);
+    }
+    {
+        pika::memotable::MemoTable table(input);
+        table.limits.set_memory_limit(4096);
+        EXPECT_ABORTED(
+            LooseStatements().packrat_match(table, 0),
+            pika::limits::Reason::MemoryExceeded);
+    }
+}
+
+#endif // PIKA_TEST_LIMITS_HPP
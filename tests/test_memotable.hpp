@@ -1,9 +1,14 @@
 #ifndef PIKA_TEST_MEMOTABLE_HPP
 #define PIKA_TEST_MEMOTABLE_HPP
 
+#include "test_parse_tree.hpp"
+
 #include <absl/hash/hash_testing.h>
+#include <algorithm>
 #include <gtest/gtest.h>
+#include <numeric>
 #include <pika/memotable.hpp>
+#include <sstream>
 #include <vector>
 
 using namespace pika::clause;
@@ -15,6 +20,159 @@ TEST(MemoKey, Hash)
          pika::memotable::MemoKey(Char<'B'>().get_instance(), 1),
          pika::memotable::MemoKey(
              Seq<Char<'A'>, Char<'B'>>().get_instance(), 1)}));
+    EXPECT_EQ(
+        pika::memotable::MemoKey(Char<'A'>().get_instance(), 3),
+        pika::memotable::MemoKey(Char<'A'>().get_instance(), 3));
+    EXPECT_LE(sizeof(pika::memotable::MemoKey), 16);
+}
+
+TEST(MemoTable, Packrat)
+{
+    pika::memotable::MemoTable table("ab");
+    auto a = Char<'a'>().clause_id();
+    auto b = Char<'b'>().clause_id();
+    EXPECT_EQ(table.packrat_find(a, 0), nullptr);
+    EXPECT_TRUE(Char<'a'>().packrat_match(table, 0));
+    EXPECT_FALSE(Char<'b'>().packrat_match(table, 0));
+    EXPECT_FALSE(Char<'a'>().packrat_match(table, 2));
+    ASSERT_NE(table.packrat_find(a, 0), nullptr);
+    EXPECT_EQ(table.packrat_find(a, 0)->get()->get_length(), 1);
+    ASSERT_NE(table.packrat_find(b, 0), nullptr);
+    EXPECT_FALSE(*table.packrat_find(b, 0));
+    ASSERT_NE(table.packrat_find(a, 2), nullptr);
+    EXPECT_FALSE(*table.packrat_find(a, 2));
+    EXPECT_EQ(table.packrat_find(b, 1), nullptr);
+    EXPECT_EQ(table.packrat_size(), 1);
+    EXPECT_TRUE(table.empty());
+}
+
+PIKA_DECLARE_UNMEMOIZED(Pair, PIKA_SEQ(Number, PIKA_CHAR(',')), true);
+PIKA_DECLARE(
+    PairList,
+    PIKA_ORD(PIKA_SEQ(Pair, Pair, Number), PIKA_SEQ(Pair, Number)),
+    true);
+
+TEST(MemoTable, Selective)
+{
+    std::vector<std::string_view> tests = {
+        "1+1", "(13*5)*2+14*(1+(5*(1+(2*3))))", "(1)*223*(11)+114514*1"};
+    for (auto i : tests)
+    {
+        pika::memotable::MemoTable full(i);
+        pika::memotable::MemoTable selective(i, Toplevel());
+        auto expected = Toplevel().packrat_match(full, 0);
+        auto match = Toplevel().packrat_match(selective, 0);
+        ASSERT_TRUE(match);
+        EXPECT_LT(selective.packrat_size(), full.packrat_size());
+        EXPECT_EQ(
+            eval(pika::parse_tree::TreeNode(*match, selective)),
+            eval(pika::parse_tree::TreeNode(*expected, full)));
+        EXPECT_EQ(selective.packrat_find(Number().clause_id(), 0), nullptr);
+        EXPECT_NE(
+            selective.packrat_find(Multiplicative().clause_id(), 0), nullptr);
+    }
+    pika::memotable::MemoTable table("12,3", PairList());
+    EXPECT_TRUE(PairList().packrat_match(table, 0));
+    EXPECT_EQ(table.packrat_find(Pair().clause_id(), 0), nullptr);
+
+    /*
+     * The first alternative fails after its first Pair, leaving nothing
+     * behind on the operand stack.
+     */
+    EXPECT_EQ(table.packrat_operand_count(), 0);
+    EXPECT_EQ(table.memory_usage(), table.measure_memory());
+}
+
+static const pika::memotable::ClauseOccupancy*
+find_occupancy(const pika::memotable::Occupancy& report, const Clause* clause)
+{
+    for (const auto& i : report.clauses)
+    {
+        if (i.clause == clause)
+        {
+            return &i;
+        }
+    }
+    return nullptr;
+}
+
+TEST(MemoTable, Occupancy)
+{
+    auto table = pika::graph::construct_table(Toplevel(), "12+(3*4)", false);
+    EXPECT_TRUE(table.match());
+    auto report = table.memo_table.occupancy(true);
+    EXPECT_EQ(report.entries, table.memo_table.size());
+    EXPECT_EQ(report.failures, 0);
+    EXPECT_EQ(
+        std::accumulate(report.histogram.begin(), report.histogram.end(), 0),
+        report.entries);
+    for (size_t i = 1; i < report.clauses.size(); ++i)
+    {
+        EXPECT_GE(report.clauses[i - 1].bytes, report.clauses[i].bytes);
+    }
+    auto digit = find_occupancy(report, Digit().get_instance());
+    ASSERT_NE(digit, nullptr);
+    EXPECT_EQ(digit->entries, 4);
+    EXPECT_EQ(digit->covered, 4);
+    EXPECT_EQ(digit->average_sub_matches(), 0);
+    auto number = find_occupancy(report, Number().get_instance());
+    ASSERT_NE(number, nullptr);
+    EXPECT_EQ(number->entries, 4);
+    EXPECT_EQ(number->covered, 4);
+    EXPECT_EQ(number->average_sub_matches(), 1.25);
+    auto toplevel = find_occupancy(report, Toplevel().get_instance());
+    ASSERT_NE(toplevel, nullptr);
+    EXPECT_EQ(toplevel->covered, 8);
+    std::ostringstream output;
+    report.dump(output, 4);
+    auto text = output.str();
+    EXPECT_EQ(
+        text.substr(0, text.find('\n')),
+        "entries=" + std::to_string(report.entries) +
+            ", failures=0, bytes=" + std::to_string(report.bytes));
+    EXPECT_NE(
+        text.find(
+            "Number <- ( Digit )+: entries=4, failures=0, bytes=" +
+            std::to_string(number->bytes) +
+            ", sub_matches=1.25, covered=4\n"),
+        std::string::npos);
+    /*
+     * The histogram of 9 positions folded into rows of 3.
+     */
+    EXPECT_EQ(
+        std::count(text.begin(), text.end(), '\n'),
+        1 + report.clauses.size() + 3);
+    EXPECT_NE(text.find("\n[6, 9): "), std::string::npos);
+
+    pika::memotable::MemoTable memo("12+(3*4)", Toplevel());
+    EXPECT_TRUE(Toplevel().packrat_match(memo, 0));
+    auto packrat = memo.occupancy();
+    EXPECT_EQ(packrat.entries, memo.packrat_size());
+    EXPECT_TRUE(packrat.histogram.empty());
+    auto multiplicative =
+        find_occupancy(packrat, Multiplicative().get_instance());
+    ASSERT_NE(multiplicative, nullptr);
+    EXPECT_EQ(multiplicative->entries, 4);
+    EXPECT_EQ(multiplicative->covered, 7);
+    output.str("");
+    packrat.dump(output);
+    text = output.str();
+    EXPECT_EQ(
+        std::count(text.begin(), text.end(), '\n'),
+        1 + packrat.clauses.size());
+    EXPECT_EQ(text.find('['), std::string::npos);
+
+    pika::memotable::MemoTable broken("1+)", Toplevel());
+    EXPECT_FALSE(Toplevel().packrat_match(broken, 0));
+    auto failed = broken.occupancy();
+    auto primary = find_occupancy(failed, Primary().get_instance());
+    ASSERT_NE(primary, nullptr);
+    EXPECT_EQ(primary->entries, 1);
+    /*
+     * Nothing can match at ')', the analysis skips those attempts.
+     */
+    EXPECT_EQ(primary->failures, 0);
+    EXPECT_EQ(failed.failures, 1);
 }
 
 #endif // PIKA_TEST_MEMOTABLE_HPP
@@ -9,6 +9,25 @@
 
 #include <pika/parse_tree.hpp>
 
+struct Expression;
+
+PIKA_DECLARE(Difference, PIKA_LEFT(PIKA_CHAR('-')), true);
+PIKA_DECLARE(Sum, PIKA_LEFT(PIKA_CHAR('+')), true);
+PIKA_DECLARE(Product, PIKA_LEFT(PIKA_CHAR('*')), true);
+PIKA_DECLARE(Power, PIKA_RIGHT(PIKA_CHAR('^')), true);
+PIKA_DECLARE(
+    Operand,
+    PIKA_ORD(PIKA_SEQ(PIKA_CHAR('('), Expression, PIKA_CHAR(')')), Number),
+    true);
+PIKA_DECLARE(
+    Expression,
+    PIKA_PRECEDENCE(Operand, Difference, Sum, Product, Power),
+    true);
+PIKA_DECLARE(
+    Calculation,
+    PIKA_SEQ(PIKA_FIRST, Expression, PIKA_NOT_FOLLOWED_BY(PIKA_ANY)),
+    true);
+
 size_t eval(const pika::parse_tree::TreeNode& node)
 {
     if (node.is_clause<Number>())
@@ -37,6 +56,31 @@ size_t eval(const pika::parse_tree::TreeNode& node)
             EXPECT_EQ(node.size(), 2);
             return eval(**node.begin()) + eval(**(node.begin() + 1));
         }
+        else if (node.is_clause<Difference>())
+        {
+            EXPECT_EQ(node.size(), 2);
+            return eval(**node.begin()) - eval(**(node.begin() + 1));
+        }
+        else if (node.is_clause<Sum>())
+        {
+            EXPECT_EQ(node.size(), 2);
+            return eval(**node.begin()) + eval(**(node.begin() + 1));
+        }
+        else if (node.is_clause<Product>())
+        {
+            EXPECT_EQ(node.size(), 2);
+            return eval(**node.begin()) * eval(**(node.begin() + 1));
+        }
+        else if (node.is_clause<Power>())
+        {
+            EXPECT_EQ(node.size(), 2);
+            size_t result = 1;
+            for (auto n = eval(**(node.begin() + 1)); n > 0; --n)
+            {
+                result *= eval(**node.begin());
+            }
+            return result;
+        }
     }
     throw std::runtime_error("unreachable");
 }
@@ -56,4 +100,127 @@ TEST(ParseTree, Build)
     }
 }
 
+TEST(ParseTree, Precedence)
+{
+    std::vector<std::pair<std::string_view, size_t>> tests = {
+        {"1+1", 2},
+        {"(13*5)*2+14*(1+(5*(1+(2*3))))", 634},
+        {"10-3-2", 5},
+        {"2^3^2", 512},
+        {"2*3^2+1-4", 15},
+        {"2*(3+1)^2", 32},
+        {"7", 7}};
+    for (auto& i : tests)
+    {
+        pika::memotable::MemoTable table(i.first);
+        auto packrat = Calculation().packrat_match(table, 0);
+        ASSERT_TRUE(packrat);
+        EXPECT_EQ(eval(pika::parse_tree::TreeNode(*packrat, table)), i.second);
+        auto pika = pika::graph::construct_table(Calculation(), i.first);
+        auto result = pika.match();
+        ASSERT_TRUE(result);
+        EXPECT_EQ(
+            eval(pika::parse_tree::TreeNode(*result, pika.memo_table)),
+            i.second);
+    }
+    for (auto input : {"1+", "2^", "(1+2", "+1", "1++2"})
+    {
+        pika::memotable::MemoTable table(input);
+        EXPECT_FALSE(Calculation().packrat_match(table, 0));
+        EXPECT_FALSE(
+            pika::graph::construct_table(Calculation(), input).match());
+    }
+
+    /*
+     * One clause climbing the operators memoizes and evaluates less than a
+     * rule per level.
+     */
+    auto input = "(1+2)*3+4*(5+6*7)+8";
+    auto ladder = pika::graph::construct_table(Toplevel(), input);
+    ASSERT_TRUE(ladder.match());
+    auto climbing = pika::graph::construct_table(Calculation(), input);
+    ASSERT_TRUE(climbing.match());
+    EXPECT_LT(
+        climbing.memo_table.occupancy().entries,
+        ladder.memo_table.occupancy().entries);
+    EXPECT_LT(
+        climbing.memo_table.counters.evaluations,
+        ladder.memo_table.counters.evaluations);
+
+    /*
+     * Columns share the operator chains to their right, so twice as long a
+     * chain costs about twice as much rather than four times.
+     */
+    auto chain = [](size_t operands) {
+        std::string input = "1";
+        for (size_t i = 1; i < operands; ++i)
+        {
+            input.append("+1");
+        }
+        auto table = pika::graph::construct_table(Calculation(), input);
+        auto result = table.match();
+        EXPECT_TRUE(result);
+        if (result)
+        {
+            EXPECT_EQ(
+                eval(pika::parse_tree::TreeNode(*result, table.memo_table)),
+                operands);
+        }
+        return std::make_pair(
+            table.memo_table.counters.hits, table.memory_usage());
+    };
+    auto shorter = chain(500);
+    auto longer = chain(1000);
+    EXPECT_LT(longer.first, shorter.first * 5 / 2);
+    EXPECT_LT(longer.second, shorter.second * 5 / 2);
+}
+
+PIKA_DECLARE(Reserved, PIKA_KEYWORDS("if else elif while in int"), true);
+PIKA_DECLARE(
+    ReservedList,
+    PIKA_SEQ(
+        PIKA_PLUS(PIKA_SEQ(Reserved, PIKA_OPTIONAL(PIKA_CHAR(' ')))),
+        PIKA_NOT_FOLLOWED_BY(PIKA_ANY)),
+    true);
+
+TEST(ParseTree, Keywords)
+{
+    EXPECT_EQ(Reserved::TRIE.count, 6);
+    EXPECT_EQ(Reserved::TRIE.longest, 5);
+    EXPECT_EQ(Reserved::keyword(3), "while");
+    /*
+     * Like an Ord, the first keyword in order wins over a longer one.
+     */
+    auto found = Reserved::TRIE.match("int");
+    EXPECT_EQ(found.first, 4);
+    EXPECT_EQ(found.second, 2);
+    EXPECT_EQ(Reserved::TRIE.match("elif").first, 2);
+    EXPECT_EQ(Reserved::TRIE.match("el").first, Reserved::TRIE.NONE);
+
+    auto input = "while elif if in";
+    std::vector<size_t> expected{3, 2, 0, 4};
+    pika::memotable::MemoTable table(input);
+    auto packrat = ReservedList().packrat_match(table, 0);
+    ASSERT_TRUE(packrat);
+    auto pika = pika::graph::construct_table(ReservedList(), input);
+    auto result = pika.match();
+    ASSERT_TRUE(result);
+    auto alternatives = [](const pika::parse_tree::TreeNode& tree) {
+        std::vector<size_t> result;
+        for (auto& i : tree)
+        {
+            EXPECT_TRUE(i->is_clause<Reserved>());
+            result.push_back(i->alternative);
+        }
+        return result;
+    };
+    EXPECT_EQ(
+        alternatives(pika::parse_tree::TreeNode(*packrat, table)), expected);
+    EXPECT_EQ(
+        alternatives(pika::parse_tree::TreeNode(*result, pika.memo_table)),
+        expected);
+    pika::memotable::MemoTable broken("while int");
+    EXPECT_FALSE(ReservedList().packrat_match(broken, 0));
+}
+
 #endif // PIKA_TEST_PARSE_TREE_HPP
@@ -0,0 +1,185 @@
+#ifndef PIKA_TEST_PEG_HPP
+#define PIKA_TEST_PEG_HPP
+
+#include "test_clause.hpp"
+#include "test_parse_tree.hpp"
+
+#include <gtest/gtest.h>
+#include <pika/graph.hpp>
+#include <pika/peg.hpp>
+
+/*
+ * The arithmetic grammar of test_clause.hpp, loaded at runtime.
+ */
+constexpr char ARITHMETIC_PEG[] = R"(
+# Digits are left out of trees.
+Toplevel <- Additive !.
+Additive <- Multiplicative '+' Additive / Multiplicative
+Multiplicative <- Primary "*" Multiplicative / Primary
+Primary <- '(' Additive ')' / Number
+Number <- Digit+
+~Digit <- [0-9]
+)";
+
+size_t eval_peg(
+    const pika::peg::Grammar& grammar,
+    const pika::peg::Node& node,
+    std::string_view input)
+{
+    auto& name = grammar.rules[node.rule].name;
+    if (name == "Number" || name == "Term")
+    {
+        return std::stoull(std::string{input.substr(node.start, node.length)});
+    }
+    else if (node.children.size() == 1)
+    {
+        return eval_peg(grammar, node.children[0], input);
+    }
+    auto lhs = eval_peg(grammar, node.children[0], input);
+    auto rhs = eval_peg(grammar, node.children[1], input);
+    if (name == "Difference")
+    {
+        return lhs - rhs;
+    }
+    return name == "Additive" ? lhs + rhs : lhs * rhs;
+}
+
+TEST(Peg, Load)
+{
+    auto grammar = pika::peg::Grammar::load(ARITHMETIC_PEG);
+    ASSERT_TRUE(grammar);
+    ASSERT_EQ(grammar->rules.size(), 6);
+    auto digit = grammar->find("Digit");
+    ASSERT_TRUE(digit);
+    EXPECT_FALSE(grammar->rules[*digit].active);
+    EXPECT_FALSE(grammar->find("Digits"));
+
+    EXPECT_FALSE(pika::peg::Grammar::load(""));
+    EXPECT_FALSE(pika::peg::Grammar::load("A <- 'a' B"));
+    EXPECT_FALSE(pika::peg::Grammar::load("A <- 'a'\nA <- 'b'"));
+    EXPECT_FALSE(pika::peg::Grammar::load("A <- ('a' / 'b'"));
+    EXPECT_FALSE(pika::peg::Grammar::load("A <- [a-z"));
+
+    /*
+     * Escapes, negated classes and a rule that is only another one.
+     */
+    auto escapes = pika::peg::Grammar::load(R"(
+        Escapes <- '\x41\t' [^a-c\]] "\"" Alias
+        Alias <- Any
+        Any <- .
+    )");
+    ASSERT_TRUE(escapes);
+    for (auto [input, length] :
+         {std::pair<std::string_view, size_t>{"A\tx\"z", 5},
+          {"A\t]\"z", pika::peg::NO_MATCH},
+          {"A\td\"", pika::peg::NO_MATCH},
+          {"A\tb\"z", pika::peg::NO_MATCH},
+          {"A\t-\"z!", 5}})
+    {
+        pika::peg::Packrat packrat(*escapes, input);
+        EXPECT_EQ(packrat.match(0, 0), length);
+        pika::peg::PikaTable pika(*escapes, input);
+        pika.match();
+        EXPECT_EQ(pika.lookup(0, 0), length);
+    }
+}
+
+TEST(Peg, Engines)
+{
+    auto grammar = pika::peg::Grammar::load(ARITHMETIC_PEG);
+    ASSERT_TRUE(grammar);
+    auto toplevel = *grammar->find("Toplevel");
+    for (auto input :
+         {"12+(3*4)", "1+)", "(((1)))", "1+2+", "19*7+1", "2*(3+4)*5"})
+    {
+        auto table = pika::graph::construct_table(Toplevel(), input);
+        auto expected = table.match();
+        pika::peg::Packrat packrat(*grammar, input);
+        pika::peg::PikaTable pika(*grammar, input);
+        pika.match();
+        auto packrat_tree = packrat.parse(toplevel);
+        auto pika_tree = pika.parse(toplevel);
+        ASSERT_EQ(packrat_tree.has_value(), expected != nullptr);
+        ASSERT_EQ(pika_tree.has_value(), expected != nullptr);
+        if (!expected)
+        {
+            continue;
+        }
+        auto value =
+            eval(pika::parse_tree::TreeNode(*expected, table.memo_table));
+        EXPECT_EQ(packrat_tree->length, expected->get_length());
+        EXPECT_EQ(pika_tree->length, expected->get_length());
+        EXPECT_EQ(eval_peg(*grammar, *packrat_tree, input), value);
+        EXPECT_EQ(eval_peg(*grammar, *pika_tree, input), value);
+
+        /*
+         * Matches at every position, not only the toplevel one.
+         */
+        auto additive = *grammar->find("Additive");
+        for (size_t i = 0; i < std::string_view{input}.size(); ++i)
+        {
+            EXPECT_EQ(packrat.match(additive, i), pika.lookup(additive, i));
+        }
+    }
+}
+
+TEST(Peg, LeftRecursion)
+{
+    auto grammar = pika::peg::Grammar::load(R"(
+        Difference <- Difference '-' Term / Term
+        Term <- [0-9]+
+    )");
+    ASSERT_TRUE(grammar);
+    std::string_view input = "9-3-2";
+
+    /*
+     * The pika interpreter grows the rule and keeps the shorter matches it
+     * was grown from in the tree.
+     */
+    pika::peg::PikaTable pika(*grammar, input);
+    pika.match();
+    auto tree = pika.parse(0);
+    ASSERT_TRUE(tree);
+    EXPECT_EQ(tree->length, 5);
+    EXPECT_EQ(eval_peg(*grammar, *tree, input), 4);
+    ASSERT_EQ(tree->children.size(), 2);
+    EXPECT_EQ(tree->children[0].length, 3);
+
+    /*
+     * The packrat interpreter stops at the first term instead.
+     */
+    pika::peg::Packrat packrat(*grammar, input);
+    EXPECT_EQ(packrat.match(0, 0), 1);
+    tree = packrat.parse(0);
+    ASSERT_TRUE(tree);
+    ASSERT_EQ(tree->children.size(), 1);
+    EXPECT_EQ(tree->children[0].length, 1);
+
+    /*
+     * Growing through the longest of several alternatives replaces the
+     * shorter ones, which are dropped once nothing refers to them.
+     */
+    auto growing =
+        pika::peg::Grammar::load("X <- X 'abc' / X 'ab' / X 'a' / 'x'");
+    ASSERT_TRUE(growing);
+    std::string repeated = "x";
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        repeated.append("abc");
+    }
+    pika::peg::PikaTable grown(*growing, repeated);
+    grown.match();
+    EXPECT_EQ(grown.lookup(0, 0), repeated.size());
+    EXPECT_LT(grown.held(), 2 * grown.entries());
+    tree = grown.parse(0);
+    ASSERT_TRUE(tree);
+    EXPECT_EQ(tree->length, repeated.size());
+    ASSERT_EQ(tree->children.size(), 1);
+    EXPECT_EQ(tree->children[0].length, repeated.size() - 3);
+
+    pika::peg::Packrat packrat_grown(*growing, repeated);
+    EXPECT_EQ(packrat_grown.match(0, 0), 1);
+    EXPECT_EQ(packrat_grown.entries(), 1);
+}
+
+#endif // PIKA_TEST_PEG_HPP
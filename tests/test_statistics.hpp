@@ -0,0 +1,87 @@
+#ifndef PIKA_TEST_STATISTICS_HPP
+#define PIKA_TEST_STATISTICS_HPP
+
+#include "test_clause.hpp"
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <pika/graph.hpp>
+#include <pika/statistics.hpp>
+#include <sstream>
+
+TEST(Statistics, Dump)
+{
+    pika::statistics::Statistics statistics;
+    EXPECT_EQ(statistics.find(Number().get_instance()), nullptr);
+    statistics[Number().get_instance()].evaluations = 1;
+    statistics[Number().get_instance()].matches = 1;
+    statistics[Additive().get_instance()].evaluations = 2;
+    statistics[Additive().get_instance()].hits = 3;
+    ASSERT_NE(statistics.find(Number().get_instance()), nullptr);
+    EXPECT_EQ(statistics.find(Number().get_instance())->matches, 1);
+    std::ostringstream output;
+    statistics.dump(output);
+    EXPECT_EQ(
+        output.str(),
+        "Additive <- ( ( Multiplicative ~ '+' ~ Additive ) / Multiplicative ): "
+        "evaluations=2, matches=0, improvements=0, rejections=0, pushes=0, "
+        "duplicates=0, hits=3, misses=0\n"
+        "Number <- ( Digit )+: evaluations=1, matches=1, improvements=0, "
+        "rejections=0, pushes=0, duplicates=0, hits=0, misses=0\n");
+    statistics.clear();
+    EXPECT_TRUE(statistics.collect().empty());
+}
+
+#ifdef PIKA_STATISTICS
+TEST(Statistics, Engines)
+{
+    auto table = pika::graph::construct_table(Toplevel(), "1+(2*3)", false);
+    EXPECT_TRUE(table.match());
+    auto& statistics = table.memo_table.statistics;
+    auto digit = statistics.find(Digit().get_instance());
+    ASSERT_NE(digit, nullptr);
+    /*
+     * Only the columns holding a digit seed it.
+     */
+    EXPECT_EQ(digit->evaluations, 3);
+    EXPECT_EQ(digit->matches, 3);
+    EXPECT_EQ(digit->improvements, 3);
+    auto number = statistics.find(Number().get_instance());
+    ASSERT_NE(number, nullptr);
+    EXPECT_EQ(number->pushes, 3);
+    EXPECT_EQ(number->matches, 3);
+    size_t evaluations = 0, pushes = 0;
+    for (auto& i : statistics.collect())
+    {
+        evaluations += i.evaluations;
+        pushes += i.pushes;
+    }
+    EXPECT_EQ(evaluations, table.memo_table.counters.evaluations);
+    EXPECT_EQ(pushes, table.memo_table.counters.pushes);
+
+    pika::memotable::MemoTable memo("1+(2*3)");
+    EXPECT_TRUE(Toplevel().packrat_match(memo, 0));
+    auto additive = memo.statistics.find(Additive().get_instance());
+    ASSERT_NE(additive, nullptr);
+    EXPECT_EQ(additive->evaluations, additive->misses);
+    EXPECT_EQ(additive->matches, 3);
+    auto multiplicative =
+        memo.statistics.find(Multiplicative().get_instance());
+    ASSERT_NE(multiplicative, nullptr);
+    EXPECT_GT(multiplicative->hits, 0);
+    std::ostringstream output;
+    memo.statistics.dump(output);
+    auto text = output.str();
+    EXPECT_EQ(
+        std::count(text.begin(), text.end(), '\n'),
+        memo.statistics.collect().size());
+    EXPECT_NE(
+        text.find(
+            "Additive <- ( ( Multiplicative ~ '+' ~ Additive ) / "
+            "Multiplicative ): evaluations=" +
+            std::to_string(additive->evaluations) + ", matches=3, "),
+        std::string::npos);
+}
+#endif
+
+#endif // PIKA_TEST_STATISTICS_HPP
@@ -0,0 +1,109 @@
+#ifndef PIKA_TEST_TOKEN_HPP
+#define PIKA_TEST_TOKEN_HPP
+
+#include "test_clause.hpp"
+
+#include <gtest/gtest.h>
+#include <pika/graph.hpp>
+#include <pika/parse_tree.hpp>
+#include <pika/token.hpp>
+
+enum TokenKind : uint8_t
+{
+    NUMBER = 1,
+    PLUS,
+    TIMES,
+    OPEN,
+    /*
+     * The same byte as EOF.
+     */
+    CLOSE = 0xFF
+};
+
+struct TokenExpression;
+
+PIKA_DECLARE(TokenNumber, PIKA_TOKEN(NUMBER), true);
+PIKA_DECLARE(
+    TokenAtom,
+    PIKA_ORD(
+        PIKA_SEQ(PIKA_TOKEN(OPEN), TokenExpression, PIKA_TOKEN(CLOSE)),
+        TokenNumber),
+    false);
+PIKA_DECLARE(TokenPlus, PIKA_LEFT(PIKA_TOKEN(PLUS)), true);
+PIKA_DECLARE(TokenTimes, PIKA_LEFT(PIKA_TOKEN(TIMES)), true);
+PIKA_DECLARE(
+    TokenExpression, PIKA_PRECEDENCE(TokenAtom, TokenPlus, TokenTimes), true);
+PIKA_DECLARE(
+    TokenProgram,
+    PIKA_SEQ(PIKA_FIRST, TokenExpression, PIKA_NOT_FOLLOWED_BY(PIKA_ANY)),
+    true);
+
+size_t eval_tokens(
+    const pika::parse_tree::TreeNode& node,
+    const pika::token::TokenStream& stream)
+{
+    if (node.is_clause<TokenNumber>())
+    {
+        auto content = stream.source_span(node.matched_content);
+        return std::stoull(std::string{content.begin(), content.end()});
+    }
+    else if (node.size() == 1)
+    {
+        return eval_tokens(**node.begin(), stream);
+    }
+    auto lhs = eval_tokens(**node.begin(), stream);
+    auto rhs = eval_tokens(**(node.begin() + 1), stream);
+    return node.is_clause<TokenPlus>() ? lhs + rhs : lhs * rhs;
+}
+
+TEST(Token, Stream)
+{
+    pika::token::Lexer lexer;
+    EXPECT_TRUE(lexer.add(NUMBER, PIKA_PLUS(PIKA_CHAR_RANGE('0', '9'))()));
+    EXPECT_TRUE(lexer.add(PLUS, PIKA_CHAR('+')()));
+    EXPECT_TRUE(lexer.add(TIMES, PIKA_CHAR('*')()));
+    EXPECT_TRUE(lexer.add(OPEN, PIKA_CHAR('(')()));
+    EXPECT_TRUE(lexer.add(CLOSE, PIKA_CHAR(')')()));
+    EXPECT_TRUE(lexer.add(lexer.SKIP, PIKA_PLUS(PIKA_CHAR(' '))()));
+    EXPECT_FALSE(lexer.add(NUMBER, Additive()));
+    EXPECT_FALSE(lexer.add(256, PIKA_CHAR('-')()));
+    EXPECT_FALSE(lexer.add(-2, PIKA_CHAR('-')()));
+    EXPECT_FALSE(lexer.tokenize("12 $ 3"));
+
+    auto source = "12 + (3 * 45) * 2";
+    auto stream = lexer.tokenize(source);
+    ASSERT_TRUE(stream);
+    ASSERT_EQ(stream->size(), 9);
+    EXPECT_EQ(stream->source_span(3, 3), "3 * 45");
+    EXPECT_EQ(stream->source_span(9, 0), "");
+
+    /*
+     * One column per token, and a token of kind 0xFF is not confused with
+     * the end of input.
+     */
+    auto table =
+        pika::graph::construct_table(TokenProgram(), stream->symbols());
+    PIKA_TOKEN(CLOSE)().pika_match(table);
+    EXPECT_TRUE(table.memo_table.empty());
+    auto result = table.match();
+    ASSERT_TRUE(result);
+    EXPECT_EQ(table.memo_table.counters.columns, stream->size() + 1);
+    pika::parse_tree::TreeNode tree(*result, table.memo_table);
+    EXPECT_EQ(eval_tokens(tree, *stream), 282);
+    EXPECT_EQ(stream->source_span(tree.matched_content), source);
+
+    pika::memotable::MemoTable memo(stream->symbols());
+    auto packrat = TokenProgram().packrat_match(memo, 0);
+    ASSERT_TRUE(packrat);
+    EXPECT_EQ(
+        eval_tokens(pika::parse_tree::TreeNode(*packrat, memo), *stream),
+        282);
+
+    auto unbalanced = lexer.tokenize("(1 + 2");
+    ASSERT_TRUE(unbalanced);
+    EXPECT_FALSE(
+        pika::graph::construct_table(TokenProgram(), unbalanced->symbols())
+            .match());
+}
+
+#endif // PIKA_TEST_TOKEN_HPP
@@ -0,0 +1,81 @@
+#ifndef PIKA_TEST_TRACE_HPP
+#define PIKA_TEST_TRACE_HPP
+
+#include "test_clause.hpp"
+
+#include <gtest/gtest.h>
+#include <pika/graph.hpp>
+#include <pika/trace.hpp>
+#include <sstream>
+
+PIKA_DECLARE(Quoted, PIKA_SEQ(PIKA_CHAR('"'), Number, PIKA_CHAR('"')), true);
+
+TEST(Trace, Pika)
+{
+    pika::trace::Tracer tracer;
+    auto table = pika::graph::construct_table(Toplevel(), "1+(2*3)");
+    table.memo_table.tracer = &tracer;
+    EXPECT_TRUE(table.match());
+    auto& events = tracer.get_events();
+    ASSERT_EQ(events.size(), 8);
+    size_t evaluations = 0;
+    for (size_t i = 0; i < events.size(); ++i)
+    {
+        EXPECT_EQ(events[i].clause, nullptr);
+        EXPECT_EQ(events[i].position, 7 - i);
+        EXPECT_GT(events[i].queue_depth, 0);
+        evaluations += events[i].evaluations;
+    }
+    EXPECT_EQ(evaluations, table.memo_table.counters.evaluations);
+    std::ostringstream output;
+    tracer.write(output);
+    auto json = output.str();
+    EXPECT_EQ(json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["), 0);
+    EXPECT_NE(
+        json.find("\"name\":\"column\",\"cat\":\"pika\",\"ph\":\"X\""),
+        std::string::npos);
+    EXPECT_NE(json.find("\"name\":\"queue\",\"ph\":\"C\""), std::string::npos);
+}
+
+TEST(Trace, Packrat)
+{
+    pika::trace::Tracer tracer;
+    pika::memotable::MemoTable table("\"12\"");
+    table.tracer = &tracer;
+    EXPECT_TRUE(Quoted().packrat_match(table, 0));
+    auto& events = tracer.get_events();
+    ASSERT_FALSE(events.empty());
+    // Events are recorded when an evaluation ends, so the outermost is last.
+    auto& outer = events.back();
+    EXPECT_EQ(outer.clause, Quoted().get_instance());
+    EXPECT_EQ(outer.position, 0);
+    size_t digits = 0;
+    for (auto& i : events)
+    {
+        EXPECT_GE(i.start, outer.start);
+        EXPECT_LE(i.start + i.duration, outer.start + outer.duration);
+        if (i.clause == Digit().get_instance())
+        {
+            EXPECT_EQ(i.position, 1 + digits++);
+        }
+    }
+    EXPECT_EQ(digits, 3);
+    std::ostringstream output;
+    tracer.write(output);
+    EXPECT_NE(
+        output.str().find("\"name\":\"Digit\",\"cat\":\"packrat\""),
+        std::string::npos);
+    EXPECT_NE(output.str().find("\"name\":\"'\\\"'\""), std::string::npos);
+
+    pika::trace::Tracer small(2);
+    pika::memotable::MemoTable again("\"12\"");
+    again.tracer = &small;
+    EXPECT_TRUE(Quoted().packrat_match(again, 0));
+    EXPECT_EQ(small.get_events().size(), 2);
+    EXPECT_EQ(small.dropped(), events.size() - 2);
+    small.clear();
+    EXPECT_TRUE(small.get_events().empty());
+    EXPECT_EQ(small.dropped(), 0);
+}
+
+#endif // PIKA_TEST_TRACE_HPP
@@ -5,5 +5,9 @@ add_executable(pika-test ${TEST_SRC})
 target_link_libraries(pika-test snmallocshim gmock gtest absl::strings absl::flat_hash_map pika)
 add_test(pika-test pika-test)
 
+add_executable(pika-complexity bench/complexity.cpp)
+target_link_libraries(pika-complexity snmallocshim gtest absl::strings absl::flat_hash_map pika)
+add_test(pika-complexity pika-complexity)
+
 
 